@@ -0,0 +1,54 @@
+#ifndef IO_MODULE_ASYNC_CSV_WRITER_H_
+#define IO_MODULE_ASYNC_CSV_WRITER_H_
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <Eigen/Core>
+
+#include "ring_buffer.h"
+
+// AsyncCsvWriter appends rows to a .csv file from a background
+// thread, so that a real-time thread only copies the row into a
+// preallocated ring buffer. Rows are dropped and counted, if the
+// disk does not keep up.
+class AsyncCsvWriter
+{
+    public:
+
+        AsyncCsvWriter(const std::string& path, int cols, size_t capacity = 1024);
+
+        // Flushes all pending rows.
+        ~AsyncCsvWriter();
+
+        // Producer. Returns false and drops the row, if the buffer is full.
+        bool Push(const Eigen::Ref<const Eigen::VectorXd>& row);
+
+        // Write all pending rows and stop the background thread.
+        void Close();
+
+        // Getters.
+        inline uint64_t GetWritten() const { return written_.load(std::memory_order_relaxed); };
+        inline uint64_t GetDropped() const { return dropped_.load(std::memory_order_relaxed); };
+
+    private:
+
+        // Background thread, which drains the buffer.
+        void Run();
+
+        const int cols_;
+
+        std::ofstream file_;
+
+        RingBuffer<Eigen::VectorXd> rows_;
+        Eigen::VectorXd row_;
+
+        std::atomic<bool> running_;
+        std::atomic<uint64_t> written_;
+        std::atomic<uint64_t> dropped_;
+
+        std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef IO_MODULE_HEARTBEAT_H_
+#define IO_MODULE_HEARTBEAT_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <yarp/os/all.h>
+
+// Heartbeat publishes a counter and the time on a port, at most
+// every period seconds. Either call Beat() from the loop, whose
+// liveness shall be monitored, or start the thread, to beat on
+// its own.
+class Heartbeat : public yarp::os::RateThread
+{
+    public:
+
+        Heartbeat(const std::string& port_name, double period = 0.05);
+
+        ~Heartbeat();
+
+        // Write a heartbeat, if the last one is older than the period.
+        void Beat();
+
+        inline const std::string& GetPortName() const { return port_name_; };
+
+    private:
+
+        // Method to be implemented for RateThread.
+        virtual void run() { Beat(); };
+
+        std::string port_name_;
+        yarp::os::BufferedPort<yarp::os::Bottle> port_;
+
+        double period_;
+        double last_;
+        int count_;
+};
+
+
+// Watchdog monitors heartbeats, and raises an emergency stop, if
+// one of them is missing for longer than the timeout, or did not
+// arrive within the grace period after the start. The flag is
+// atomic, so that control loops only need to read it.
+class Watchdog : public yarp::os::RateThread
+{
+    public:
+
+        Watchdog(const std::string& name, double period = 0.05, double timeout = 0.5, double grace = 5.);
+
+        ~Watchdog();
+
+        // Monitor the heartbeat, which is published on source.
+        void Watch(const std::string& source);
+
+        // Raise the emergency stop.
+        void Trigger(const std::string& reason);
+
+        inline bool EmergencyStop() const { return estop_.load(std::memory_order_acquire); };
+
+    private:
+
+        // Receives the heartbeats of one source.
+        class Monitor : public yarp::os::TypedReaderCallback<yarp::os::Bottle>
+        {
+            public:
+
+                Monitor(const std::string& source, const std::string& local);
+
+                ~Monitor();
+
+                using yarp::os::TypedReaderCallback<yarp::os::Bottle>::onRead;
+                virtual void onRead(yarp::os::Bottle& beat);
+
+                const std::string source;
+                const std::string local;
+
+                yarp::os::BufferedPort<yarp::os::Bottle> port;
+
+                // Time of the last heartbeat, negative before the first one.
+                std::atomic<double> last;
+        };
+
+        // Methods to be implemented for RateThread.
+        virtual bool threadInit();
+
+        virtual void run();
+
+        std::string name_;
+
+        double timeout_;
+        double grace_;
+        double start_;
+
+        std::vector<std::unique_ptr<Monitor>> monitors_;
+
+        std::atomic<bool> estop_;
+};
+
+#endif
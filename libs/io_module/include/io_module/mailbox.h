@@ -0,0 +1,67 @@
+#ifndef IO_MODULE_MAILBOX_H_
+#define IO_MODULE_MAILBOX_H_
+
+#include <atomic>
+#include <cstdint>
+
+// Mailbox hands the latest value from a single producer to a
+// single consumer, without locks. It is a triple buffer: the
+// producer writes into a slot of its own and swaps it with the
+// shared slot, and the consumer swaps the shared slot with a slot
+// of its own, if it holds a newer value. Pushing never fails and
+// overwrites the value the consumer has not taken yet, so that the
+// consumer always gets the most recent one, however far it falls
+// behind. The slots are allocated on construction, by copying a
+// prototype.
+template<typename T>
+class Mailbox
+{
+    public:
+
+        Mailbox(const T& prototype = T())
+          : slots_{prototype, prototype, prototype},
+            back_(0),
+            middle_(1),
+            front_(2) { };
+
+        // Producer. Overwrites the value, which has not been taken yet, and
+        // returns false, if there was one.
+        bool Push(const T& element) {
+
+            slots_[back_] = element;
+            const uint8_t middle = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel);
+            back_ = middle & INDEX;
+
+            return !(middle & FRESH);
+        };
+
+        // Consumer. Returns false, if there is no value since the last call.
+        bool PopLatest(T& element) {
+
+            if (!(middle_.load(std::memory_order_relaxed) & FRESH)) {
+                return false;
+            }
+
+            front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+            element = slots_[front_];
+
+            return true;
+        };
+
+        inline bool Empty() const { return !(middle_.load(std::memory_order_acquire) & FRESH); };
+
+    private:
+
+        // The shared slot carries its index and whether it holds a value, which has not been taken.
+        static const uint8_t INDEX = 0x3;
+        static const uint8_t FRESH = 0x4;
+
+        T slots_[3];
+
+        // Slot of the producer, the shared slot and the slot of the consumer, on separate cache lines.
+        alignas(64) uint8_t back_;
+        alignas(64) std::atomic<uint8_t> middle_;
+        alignas(64) uint8_t front_;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef IO_MODULE_PIPELINE_H_
+#define IO_MODULE_PIPELINE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <yarp/os/all.h>
+
+#include "mailbox.h"
+#include "ring_buffer.h"
+
+// Pipeline runs a chain of stages, each on its own thread, which
+// hand work items over through bounded queues. While a stage works
+// on one item, the stage before it can already work on the next
+// one. Items carry the time of the measurement they stem from, in
+// a member time. A stage drops items, which are older than its
+// deadline. A stage waits for room in the queue of the next stage,
+// so that a slow stage holds back the ones before it, instead of
+// losing their work. A stage, which only takes the latest item,
+// has a mailbox instead of a queue, and a new item replaces the
+// one, which waits there. Items, which find the queue of the first
+// stage full, are dropped.
+template<typename T>
+class Pipeline
+{
+    public:
+
+        // A stage processes an item in place, and returns false to drop it.
+        typedef std::function<bool(T&)> Stage;
+
+        Pipeline(size_t queue_size, const T& prototype = T())
+          : queue_size_(queue_size),
+            prototype_(prototype),
+            running_(false) { };
+
+        ~Pipeline() { Stop(); };
+
+        // Add a stage. Items, which are older than deadline seconds, are dropped
+        // before the stage, 0 disables the deadline. With latest, the stage takes
+        // the most recent item, which replaces a waiting one. The init function is called on the
+        // thread of the stage, before the first item.
+        void AddStage(const std::string& name, Stage stage, double deadline = 0., bool latest = false,
+                      std::function<void()> init = std::function<void()>()) {
+
+            stages_.emplace_back(new StageData(name, stage, deadline, latest, init, queue_size_, prototype_));
+        };
+
+        void Start() {
+
+            if (running_.exchange(true)) {
+                return;
+            }
+
+            for (uint i = 0; i < stages_.size(); i++) {
+                stages_[i]->thread = std::thread(&Pipeline::Run, this, i);
+            }
+        };
+
+        // Stop all stages, items in the queues are dropped.
+        void Stop() {
+
+            if (!running_.exchange(false)) {
+                return;
+            }
+
+            for (auto& stage : stages_) {
+                stage->cv.notify_all();
+                stage->space.notify_all();
+            }
+
+            for (auto& stage : stages_) {
+                stage->thread.join();
+            }
+        };
+
+        // Feed an item to the first stage, without waiting. Returns false and drops it,
+        // if the queue is full. A latest stage replaces the waiting item instead.
+        bool Push(const T& item) { return Forward(0, item, false); };
+
+        // Getters, per stage.
+        inline size_t             GetStages()        const { return stages_.size(); };
+        inline const std::string& GetName(int i)     const { return stages_[i]->name; };
+        inline uint64_t           GetProcessed(int i) const { return stages_[i]->processed.load(std::memory_order_relaxed); };
+        inline uint64_t           GetDropped(int i)  const { return stages_[i]->dropped.load(std::memory_order_relaxed); };
+
+        // Index of a stage by its name, -1 if there is none.
+        int GetStage(const std::string& name) const {
+
+            for (uint i = 0; i < stages_.size(); i++) {
+                if (stages_[i]->name == name) {
+                    return i;
+                }
+            }
+
+            return -1;
+        };
+
+        // Moving averages of the run time of a stage, and of the time from the
+        // measurement to the end of the stage, in seconds.
+        inline double GetDuration(int i) const { return stages_[i]->duration.load(std::memory_order_relaxed); };
+        inline double GetLatency(int i)  const { return stages_[i]->latency.load(std::memory_order_relaxed); };
+
+        // Print a summary.
+        void Print(std::ostream& os = std::cout) const {
+
+            os << "Pipeline:" << std::endl;
+
+            for (uint i = 0; i < stages_.size(); i++) {
+                os << "  " << std::setw(12) << std::left << GetName(i)
+                   << " processed " << GetProcessed(i)
+                   << ", dropped " << GetDropped(i)
+                   << ", duration " << GetDuration(i)*1e3 << " ms"
+                   << ", latency " << GetLatency(i)*1e3 << " ms" << std::endl;
+            }
+        };
+
+    private:
+
+        struct StageData {
+
+            StageData(const std::string& name, Stage stage, double deadline, bool latest,
+                      std::function<void()> init, size_t queue_size, const T& prototype)
+              : name(name), stage(stage), deadline(deadline), latest(latest), init(init),
+                queue(latest ? nullptr : new RingBuffer<T>(queue_size, prototype)),
+                mailbox(latest ? new Mailbox<T>(prototype) : nullptr),
+                item(prototype),
+                processed(0), dropped(0), duration(0.), latency(0.) { };
+
+            const std::string name;
+            const Stage stage;
+            const double deadline;
+            const bool latest;
+            const std::function<void()> init;
+
+            // Input queue, or mailbox of a latest stage, with a single producer, the
+            // stage before, and a single consumer.
+            std::unique_ptr<RingBuffer<T>> queue;
+            std::unique_ptr<Mailbox<T>> mailbox;
+            T item;
+
+            // Returns false, if the item was dropped, or replaced a waiting one.
+            bool Push(const T& item) { return mailbox ? mailbox->Push(item) : queue->Push(item); };
+            bool Pop(T& item)        { return mailbox ? mailbox->PopLatest(item) : queue->Pop(item); };
+            bool Empty() const       { return mailbox ? mailbox->Empty() : queue->Empty(); };
+
+            std::thread thread;
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::condition_variable space;
+
+            std::atomic<uint64_t> processed;
+            std::atomic<uint64_t> dropped;
+            std::atomic<double> duration;
+            std::atomic<double> latency;
+        };
+
+        // Weight of the latest sample in the moving averages.
+        static constexpr double ALPHA = 0.1;
+
+        // Hand an item to stage i. With wait, wait for room in the queue. A latest
+        // stage always takes the item, and counts the one it replaces as dropped.
+        bool Forward(uint i, const T& item, bool wait) {
+
+            StageData& stage = *stages_[i];
+
+            bool pushed = stage.Push(item);
+
+            if (!pushed && wait && !stage.latest) {
+
+                std::unique_lock<std::mutex> lock(stage.mutex);
+
+                while (running_ && !(pushed = stage.queue->Push(item))) {
+                    stage.space.wait_for(lock, std::chrono::milliseconds(10));
+                }
+            }
+
+            if (!pushed) {
+                stage.dropped.fetch_add(1, std::memory_order_relaxed);
+
+                if (!stage.latest) {
+                    return false;
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(stage.mutex);
+            }
+            stage.cv.notify_one();
+
+            return true;
+        };
+
+        void Run(uint i) {
+
+            StageData& stage = *stages_[i];
+
+            if (stage.init) {
+                stage.init();
+            }
+
+            while (running_) {
+
+                // Wait for an item.
+                bool popped = stage.Pop(stage.item);
+
+                if (!popped) {
+
+                    std::unique_lock<std::mutex> lock(stage.mutex);
+                    stage.cv.wait_for(lock, std::chrono::milliseconds(10), [&] { return !stage.Empty() || !running_; });
+                    continue;
+                }
+
+                // Wake the stage before, if it waits for room.
+                {
+                    std::lock_guard<std::mutex> lock(stage.mutex);
+                }
+                stage.space.notify_one();
+
+                double start = yarp::os::Time::now();
+
+                // Drop stale items.
+                if (stage.deadline > 0. && start - stage.item.time > stage.deadline) {
+                    stage.dropped.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                bool ok = stage.stage(stage.item);
+                double stop = yarp::os::Time::now();
+
+                stage.duration.store((1. - ALPHA)*stage.duration.load(std::memory_order_relaxed) + ALPHA*(stop - start), std::memory_order_relaxed);
+                stage.latency.store((1. - ALPHA)*stage.latency.load(std::memory_order_relaxed) + ALPHA*(stop - stage.item.time), std::memory_order_relaxed);
+
+                if (!ok) {
+                    stage.dropped.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                stage.processed.fetch_add(1, std::memory_order_relaxed);
+
+                if (i + 1 < stages_.size()) {
+                    Forward(i + 1, stage.item, true);
+                }
+            }
+        };
+
+        size_t queue_size_;
+        T prototype_;
+
+        std::vector<std::unique_ptr<StageData>> stages_;
+        std::atomic<bool> running_;
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <chrono>
+#include <memory>
 #include <yarp/dev/all.h>
 #include <yarp/os/all.h>
 #include <yarp/sig/all.h>
@@ -11,6 +12,11 @@
 #include <yaml-cpp/yaml.h>
 
 #include "utils.h"
+#include "heartbeat.h"
+#include "mailbox.h"
+#include "realtime.h"
+#include "tick_statistics.h"
+#include "shared_image_ring.h"
 
 
 // ReadJointsToFile implements a simple reader that
@@ -30,12 +36,20 @@ class ReadJoints : public yarp::os::RateThread
         inline const std::string& GetPortName() const { return port_name_; };
         inline const Eigen::VectorXd& GetMinAngles() const { return q_min_; };
         inline const Eigen::VectorXd& GetMaxAngles() const { return q_max_; };
+        inline const std::string& GetTransport() const { return transport_; };
+
+        // Mailbox to read the latest joint state from, if the transport is in_process.
+        inline Mailbox<JointState>& GetStateBuffer() { return *states_; };
 
     private:
 
         // Methods to be implemented for RateThread.
+        virtual bool threadInit();
+
         virtual void run();
 
+        virtual void threadRelease();
+
         // Write data to file.
         //WriteCsv();
 
@@ -72,6 +86,22 @@ class ReadJoints : public yarp::os::RateThread
         // Port to write joint angles to.
         std::string port_name_;
         yarp::os::BufferedPort<yarp::sig::Matrix> port_;
+
+        // Time stamp of the state, sent in the envelope, to align other sensors with it.
+        yarp::os::Stamp stamp_;
+
+        // In-process transport.
+        std::string transport_;
+        JointState joint_state_;
+        std::unique_ptr<Mailbox<JointState>> states_;
+
+        // Tick statistics, published on a port every stats_interval_ seconds.
+        TickStatistics stats_;
+        double stats_interval_;
+        yarp::os::BufferedPort<yarp::os::Bottle> port_stats_;
+
+        // Heartbeat, to signal that this thread is alive.
+        Heartbeat heartbeat_;
 };
 
 
@@ -94,8 +124,12 @@ class ReadCameras : public yarp::os::RateThread
     private:
 
         // Methods to be implemented for RateThread.
+        virtual bool threadInit();
+
         virtual void run();
 
+        virtual void threadRelease();
+
         // Configurations.
         void UnsetDrivers();
 
@@ -103,6 +137,13 @@ class ReadCameras : public yarp::os::RateThread
 
         void SetDrivers();
 
+        // Crop, scale and convert an image in a single pass.
+        void Roi(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& in, const CameraOutput& out, int& x0, int& y0, int& w, int& h);
+
+        void OutputSize(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& in, const CameraOutput& out, int& width, int& height, int& channels);
+
+        void ProcessImage(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& in, const CameraOutput& out, unsigned char* data, size_t row_size);
+
         // Robot.
         const std::string robot_name_;
 
@@ -122,8 +163,21 @@ class ReadCameras : public yarp::os::RateThread
         // Images of the cameras.
         std::map<std::string, yarp::sig::ImageOf<yarp::sig::PixelRgb>> imgs_;
 
-        // Port to write joint angles to.
-        std::map<std::string, yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb>>> ports_;
+        // Processing of the images, and number of ticks so far.
+        std::map<std::string, CameraOutput> outputs_;
+        int ticks_;
+
+        // Port to write images to. Readers of ImageOf<PixelRgb> convert grayscale images on read.
+        std::map<std::string, yarp::os::BufferedPort<yarp::sig::FlexImage>> ports_;
+
+        // Shared memory for consumers on the same host, named /read_cameras_<camera>.
+        bool shared_images_;
+        std::map<std::string, std::unique_ptr<SharedImageRing>> rings_;
+
+        // Tick statistics, published on a port every stats_interval_ seconds.
+        TickStatistics stats_;
+        double stats_interval_;
+        yarp::os::BufferedPort<yarp::os::Bottle> port_stats_;
 };
 
 
@@ -181,6 +235,9 @@ class AppReader : public yarp::os::BufferedPort<yarp::os::Bottle>
 
         // Mutex.
         yarp::os::Mutex mutex_;
+
+        // Heartbeat, which stops on an emergency stop.
+        Heartbeat heartbeat_;
 };
 
 
@@ -254,6 +311,9 @@ class KeyReader : public yarp::os::BufferedPort<yarp::os::Bottle>
 
         // Mutex.
         yarp::os::Mutex mutex_;
+
+        // Heartbeat, which stops on an emergency stop.
+        Heartbeat heartbeat_;
 };
 
 #endif
@@ -0,0 +1,32 @@
+#ifndef IO_MODULE_REALTIME_H_
+#define IO_MODULE_REALTIME_H_
+
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+
+// Real-time settings of a thread.
+struct RealtimeConfigs {
+
+    // SCHED_FIFO priority, 0 keeps the default scheduler.
+    int priority;
+
+    // Cores to run on, empty keeps all cores.
+    std::vector<int> cpus;
+
+    // Lock all current and future memory of the process, once for all threads.
+    bool lock_memory;
+
+    // Bytes of stack to touch in advance, to avoid page faults later on.
+    int prefault_stack;
+};
+
+// Read the settings of a thread from the realtime node of the configurations.
+// Threads without an entry keep the defaults.
+RealtimeConfigs ReadRealtimeConfigs(const YAML::Node& configs, const std::string& thread);
+
+// Apply the settings to the calling thread, and report what was actually
+// granted. Settings that are not permitted are reported, but not fatal.
+void SetRealtime(const RealtimeConfigs& configs, const std::string& thread);
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef IO_MODULE_RING_BUFFER_H_
+#define IO_MODULE_RING_BUFFER_H_
+
+#include <atomic>
+#include <vector>
+
+// RingBuffer implements a lock-free single producer, single
+// consumer queue. All slots are allocated on construction, by
+// copying a prototype, so that pushing and popping only copy
+// into existing storage. A full buffer rejects new elements, so
+// that none of the queued ones is lost. Use a Mailbox, if only
+// the latest element matters.
+template<typename T>
+class RingBuffer
+{
+    public:
+
+        RingBuffer(size_t capacity, const T& prototype = T())
+          : slots_(capacity + 1, prototype),
+            head_(0),
+            tail_(0) { };
+
+        // Producer. Returns false and drops the element, if the buffer is full.
+        bool Push(const T& element) {
+
+            const size_t head = head_.load(std::memory_order_relaxed);
+            const size_t next = Next(head);
+
+            if (next == tail_.load(std::memory_order_acquire)) {
+                return false;
+            }
+
+            slots_[head] = element;
+            head_.store(next, std::memory_order_release);
+
+            return true;
+        };
+
+        // Consumer. Returns false, if the buffer is empty.
+        bool Pop(T& element) {
+
+            const size_t tail = tail_.load(std::memory_order_relaxed);
+
+            if (tail == head_.load(std::memory_order_acquire)) {
+                return false;
+            }
+
+            element = slots_[tail];
+            tail_.store(Next(tail), std::memory_order_release);
+
+            return true;
+        };
+
+        // Consumer. Takes the most recent element in the buffer and drops all older
+        // ones. Elements, which were rejected by a full buffer, are not among them.
+        bool PopLatest(T& element) {
+
+            const size_t tail = tail_.load(std::memory_order_relaxed);
+            const size_t head = head_.load(std::memory_order_acquire);
+
+            if (tail == head) {
+                return false;
+            }
+
+            element = slots_[(head + slots_.size() - 1) % slots_.size()];
+            tail_.store(head, std::memory_order_release);
+
+            return true;
+        };
+
+        inline bool Empty() const { return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire); };
+
+    private:
+
+        inline size_t Next(size_t i) const { return (i + 1) % slots_.size(); };
+
+        // Preallocated slots, one is kept free to distinguish full from empty.
+        std::vector<T> slots_;
+
+        // Producer and consumer indices on separate cache lines.
+        alignas(64) std::atomic<size_t> head_;
+        alignas(64) std::atomic<size_t> tail_;
+};
+
+#endif
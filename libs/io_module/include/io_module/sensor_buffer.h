@@ -0,0 +1,74 @@
+#ifndef IO_MODULE_SENSOR_BUFFER_H_
+#define IO_MODULE_SENSOR_BUFFER_H_
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <yarp/os/all.h>
+#include <yarp/sig/all.h>
+#include <yarp/eigen/Eigen.h>
+#include <Eigen/Core>
+
+// SensorBuffer keeps the most recent samples of a sensor, that
+// publishes vectors on a port, together with their time stamps.
+// The samples are received by a port callback, so reading the
+// port never blocks the consumer. The capacity is fixed, and the
+// oldest samples are overwritten.
+class SensorBuffer : public yarp::os::TypedReaderCallback<yarp::sig::Vector>
+{
+    public:
+
+        SensorBuffer(size_t capacity, int dim);
+
+        ~SensorBuffer();
+
+        // Open the port, on which the samples are received.
+        bool Open(const std::string& name);
+
+        void Close();
+
+        // Queue every sample for the callback, instead of only the latest one, if
+        // the callback falls behind, as for a replay at maximum speed.
+        void SetStrict(bool strict = true);
+
+        // Callback, the time stamp is taken from the envelope of the sender,
+        // or the time of arrival, if the sender does not stamp its data.
+        using yarp::os::TypedReaderCallback<yarp::sig::Vector>::onRead;
+        virtual void onRead(yarp::sig::Vector& sample);
+
+        // Add a sample, also for senders other than the port.
+        void Push(double time, const Eigen::Ref<const Eigen::VectorXd>& sample);
+
+        // Interpolate the sample at time, from the two samples around it. Outside the
+        // buffered range the closest sample is taken. Returns false, if there are no
+        // samples, and writes the distance to the closest sample to dt, if given.
+        bool Align(double time, Eigen::Ref<Eigen::VectorXd> sample, double* dt = YARP_NULLPTR);
+
+        // Getters.
+        inline const std::string& GetPortName() const { return name_; };
+        inline int GetDim() const { return dim_; };
+
+        size_t GetSize();
+
+    private:
+
+        // i-th oldest slot.
+        inline size_t Slot(size_t i) const { return (head_ + capacity_ - size_ + i) % capacity_; };
+
+        std::string name_;
+        yarp::os::BufferedPort<yarp::sig::Vector> port_;
+
+        const size_t capacity_;
+        const int dim_;
+
+        // Preallocated samples, one per column, and their time stamps.
+        Eigen::MatrixXd samples_;
+        std::vector<double> times_;
+
+        size_t head_;
+        size_t size_;
+
+        std::mutex mutex_;
+};
+
+#endif
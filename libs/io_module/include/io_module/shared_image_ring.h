@@ -0,0 +1,102 @@
+#ifndef IO_MODULE_SHARED_IMAGE_RING_H_
+#define IO_MODULE_SHARED_IMAGE_RING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Frame in a shared image ring. The data points into shared memory and
+// stays valid until the producer overwrites the slot, see Valid(). The
+// sequence number counts the writes to the slot, written counts the frames
+// of the whole ring up to this one, and is unique per frame.
+struct SharedFrame {
+    uint64_t seq;
+    uint64_t written;
+    int slot;
+    double time;
+    int width;
+    int height;
+    int channels;
+    const unsigned char* data;
+};
+
+
+// SharedImageRing implements a multi-slot image buffer in POSIX
+// shared memory, for a single producer and any number of consumers
+// on the same host. Every slot is guarded by a sequence number,
+// which is odd while the producer writes to it, so consumers can
+// use frames in place and check afterwards that they were not
+// overwritten in the meantime.
+class SharedImageRing
+{
+    public:
+
+        SharedImageRing(const std::string& name);
+
+        ~SharedImageRing();
+
+        // Producer. Create the ring, slot_size is the maximum number of bytes per image.
+        bool Create(int slots, size_t slot_size);
+
+        // Producer. Get the memory for the next image, and publish it with its time stamp.
+        unsigned char* BeginWrite(int width, int height, int channels);
+
+        void EndWrite(double time);
+
+        // Consumer. Open a ring that was created by a producer.
+        bool Open();
+
+        // Consumer. Get the most recent frame, or the frame closest to a time stamp.
+        bool ReadLatest(SharedFrame& frame) const;
+
+        bool ReadClosest(double time, SharedFrame& frame) const;
+
+        // Consumer. Check that a frame was not overwritten while it was used.
+        bool Valid(const SharedFrame& frame) const;
+
+        // Getters.
+        inline bool               IsOpen()  const { return base_ != nullptr; };
+        inline const std::string& GetName() const { return name_; };
+
+    private:
+
+        // Layout of the shared memory.
+        struct Header {
+            uint32_t magic;
+            uint32_t slots;
+            uint64_t slot_size;
+            uint64_t slot_stride;
+            std::atomic<uint64_t> written;
+        };
+
+        struct Slot {
+            std::atomic<uint64_t> seq;
+            double time;
+            int32_t width;
+            int32_t height;
+            int32_t channels;
+        };
+
+        inline Slot* GetSlot(int i) const { return reinterpret_cast<Slot*>(base_ + data_offset_ + i*header_->slot_stride); };
+        inline unsigned char* GetData(int i) const { return reinterpret_cast<unsigned char*>(GetSlot(i)) + slot_header_; };
+
+        // Read a slot, if it is not being written.
+        bool ReadSlot(int i, SharedFrame& frame) const;
+
+        void Close();
+
+        std::string name_;
+        bool owner_;
+
+        unsigned char* base_;
+        size_t size_;
+        Header* header_;
+
+        size_t data_offset_;
+        size_t slot_header_;
+
+        // Slot the producer currently writes to.
+        int writing_;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef IO_MODULE_SPLINE_H_
+#define IO_MODULE_SPLINE_H_
+
+#include <Eigen/Core>
+
+// CubicSpline interpolates several signals, e.g. joint angles,
+// through common knots, with twice continuously differentiable
+// segments. The first derivatives at both ends are prescribed, so
+// that consecutive splines join smoothly. Storage is reused, as
+// long as the number of knots and signals does not change.
+class CubicSpline
+{
+    public:
+
+        CubicSpline();
+
+        // Fit through the knots y, one column per knot at the increasing times t,
+        // with the first derivatives v0 at the first and v1 at the last knot.
+        void Fit(const Eigen::Ref<const Eigen::VectorXd>& t,
+                 const Eigen::Ref<const Eigen::MatrixXd>& y,
+                 const Eigen::Ref<const Eigen::VectorXd>& v0,
+                 const Eigen::Ref<const Eigen::VectorXd>& v1);
+
+        // Evaluate value and first derivative at time t. Before the first and
+        // after the last knot, the spline holds the value of that knot.
+        void Evaluate(double t, Eigen::Ref<Eigen::VectorXd> y, Eigen::Ref<Eigen::VectorXd> dy) const;
+
+        // Remove all knots.
+        inline void Clear() { t_.resize(0); };
+
+        // Getters.
+        inline bool   Empty() const { return t_.size() < 2; };
+        inline double Begin() const { return t_(0); };
+        inline double End()   const { return t_(t_.size() - 1); };
+
+    private:
+
+        // Knots.
+        Eigen::VectorXd t_;
+        Eigen::MatrixXd y_;
+
+        // Second derivatives at the knots.
+        Eigen::MatrixXd m_;
+
+        // Tridiagonal system.
+        Eigen::VectorXd c_;
+        Eigen::MatrixXd d_;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef IO_MODULE_TICK_STATISTICS_H_
+#define IO_MODULE_TICK_STATISTICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <yarp/os/all.h>
+
+// Histogram implements a lock-free histogram of durations. It
+// may be filled by one thread and read by others at the same time.
+class Histogram
+{
+    public:
+
+        Histogram(double bin = 1e-4, int bins = 100);
+
+        // Add a duration in seconds. The last bin collects everything above.
+        void Add(double value);
+
+        // Getters.
+        inline uint64_t GetCount() const { return count_.load(std::memory_order_relaxed); };
+        inline int      GetBins()  const { return bins_; };
+        inline double   GetBin()   const { return bin_;  };
+        inline uint64_t GetHist(int i) const { return hist_[i].load(std::memory_order_relaxed); };
+
+        double GetMean() const;
+        double GetMax() const;
+
+        // Upper bound of the bin that contains the p-th percentile.
+        double GetPercentile(double p) const;
+
+    private:
+
+        double bin_;
+        int bins_;
+
+        std::unique_ptr<std::atomic<uint64_t>[]> hist_;
+
+        // Aggregates in nanoseconds.
+        std::atomic<uint64_t> count_;
+        std::atomic<uint64_t> sum_;
+        std::atomic<uint64_t> max_;
+};
+
+
+// TickStatistics records the actual period, the run duration and
+// the deadline misses of a periodic thread.
+class TickStatistics
+{
+    public:
+
+        TickStatistics(const std::string& name, double period, double bin = 1e-4, int bins = 100, double miss_tol = 0.1);
+
+        // Call at the start and the end of every tick.
+        void Start();
+
+        void Stop();
+
+        // Record a tick directly, in seconds.
+        void Record(double period, double duration);
+
+        // Getters.
+        inline const Histogram& GetPeriod()   const { return period_hist_;   };
+        inline const Histogram& GetDuration() const { return duration_hist_; };
+        inline uint64_t         GetMisses()   const { return misses_.load(std::memory_order_relaxed); };
+
+        // Write a summary to a bottle, e.g. to publish it on a port.
+        void Write(yarp::os::Bottle& bottle) const;
+
+        // Write a summary to a port, at most every interval seconds.
+        void Publish(yarp::os::BufferedPort<yarp::os::Bottle>& port, double interval);
+
+        // Print a summary.
+        void Print(std::ostream& os = std::cout) const;
+
+    private:
+
+        std::string name_;
+
+        // Nominal period, and tolerated relative lateness of a tick.
+        double period_;
+        double miss_tol_;
+
+        Histogram period_hist_;
+        Histogram duration_hist_;
+
+        std::atomic<uint64_t> misses_;
+
+        // Start of the current and the previous tick, only used by the recording thread.
+        std::chrono::steady_clock::time_point start_;
+        bool started_;
+        double last_period_;
+
+        // Time of the last publication.
+        double published_;
+};
+
+#endif
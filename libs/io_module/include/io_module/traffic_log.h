@@ -0,0 +1,133 @@
+#ifndef IO_MODULE_TRAFFIC_LOG_H_
+#define IO_MODULE_TRAFFIC_LOG_H_
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <yarp/os/all.h>
+
+// A message, as it was received on a port. The data is the
+// serialized content, independent of its type.
+struct TrafficMessage {
+
+    // Index of the port in the log.
+    uint32_t channel;
+
+    // Time of arrival at the recorder.
+    double time;
+
+    // Envelope of the sender, count < 0 if there was none.
+    int32_t count;
+    double stamp;
+
+    std::vector<char> data;
+};
+
+// Entry of the index at the end of the log.
+struct TrafficIndex {
+
+    uint64_t offset;
+    double time;
+    uint32_t channel;
+};
+
+
+// RawMessage reads and writes the serialized content of any
+// message, so that it can be stored and sent again unchanged.
+class RawMessage : public yarp::os::PortReader, public yarp::os::PortWriter
+{
+    public:
+
+        virtual bool read(yarp::os::ConnectionReader& connection);
+
+        virtual bool write(yarp::os::ConnectionWriter& connection) const;
+
+        std::vector<char> data;
+};
+
+
+// TrafficLogWriter writes messages of several ports to a binary
+// log. The names of the ports are stored in the header, and an
+// index of all messages is appended on Close(). Messages may be
+// written by several threads.
+class TrafficLogWriter
+{
+    public:
+
+        TrafficLogWriter(const std::string& path, const std::vector<std::string>& channels);
+
+        ~TrafficLogWriter();
+
+        void Write(const TrafficMessage& msg);
+
+        // Append the index.
+        void Close();
+
+        inline uint64_t GetSize() const { return index_.size(); };
+
+    private:
+
+        std::ofstream file_;
+        std::vector<TrafficIndex> index_;
+        std::mutex mutex_;
+};
+
+
+// TrafficLogReader reads a log of TrafficLogWriter. Logs, which
+// were not closed, are indexed by scanning the messages.
+class TrafficLogReader
+{
+    public:
+
+        TrafficLogReader(const std::string& path);
+
+        // Read the i-th message.
+        bool Read(uint64_t i, TrafficMessage& msg);
+
+        // Index of the first message, which arrived at or after time.
+        uint64_t Seek(double time) const;
+
+        // Getters.
+        inline const std::vector<std::string>& GetChannels() const { return channels_; };
+        inline const std::vector<TrafficIndex>& GetIndex() const { return index_; };
+        inline uint64_t GetSize() const { return index_.size(); };
+
+    private:
+
+        // Build the index from the messages.
+        void Scan(uint64_t begin);
+
+        std::ifstream file_;
+        std::vector<std::string> channels_;
+        std::vector<TrafficIndex> index_;
+};
+
+
+// TrafficTap records all messages, that arrive on a port, to a log.
+class TrafficTap : public yarp::os::PortReader
+{
+    public:
+
+        TrafficTap(TrafficLogWriter& log, uint32_t channel);
+
+        // Open the port and connect the source to it.
+        bool Open(const std::string& name, const std::string& source);
+
+        void Close();
+
+        virtual bool read(yarp::os::ConnectionReader& connection);
+
+        inline uint64_t GetCount() const { return count_; };
+
+    private:
+
+        TrafficLogWriter& log_;
+        yarp::os::Port port_;
+
+        TrafficMessage msg_;
+        uint64_t count_;
+};
+
+#endif
@@ -23,4 +23,34 @@ struct Part {
     std::vector<std::string> cameras;
 };
 
+// Processing of a camera image before it is published. An empty region of
+// interest keeps the whole image, a width or height of zero keeps the size of
+// the region of interest, and only every decimation-th frame is published.
+struct CameraOutput {
+    std::vector<int> roi;
+    int width;
+    int height;
+    bool grayscale;
+    int decimation;
+};
+
+// Joint state and command for the in-process transport. The state holds
+// positions, velocities and accelerations as columns, all in radian.
+struct JointState {
+    double time;
+    Eigen::MatrixXd state;
+};
+
+struct JointCommand {
+    double time;
+    Eigen::VectorXd q;
+};
+
+// Trajectory segment of joint angles in radian, one column per knot, at the
+// absolute times of the knots. On a port, the times are sent as first row.
+struct JointSegment {
+    Eigen::VectorXd time;
+    Eigen::MatrixXd q;
+};
+
 #endif
\ No newline at end of file
@@ -2,12 +2,18 @@
 #define IO_MODULE_WRITE_H_
 
 #include <iostream>
+#include <memory>
 #include <yarp/os/all.h>
 #include <yarp/dev/all.h>
 #include <yaml-cpp/yaml.h>
 #include <yarp/eigen/Eigen.h>
 
 #include "utils.h"
+#include "heartbeat.h"
+#include "mailbox.h"
+#include "realtime.h"
+#include "spline.h"
+#include "tick_statistics.h"
 
 // Wrapper class for YARP to write to ports.
 //
@@ -24,12 +30,25 @@ class WriteJoints : public yarp::os::RateThread
         // Getters.
         inline const std::string& GetPortName()           const { return port_name_; };
         inline const RobotStatus& GetRobotStatus()        const { return robot_status_; };
+        inline const std::string& GetTransport()          const { return transport_; };
+        inline const std::string& GetSegmentPortName()    const { return segment_port_name_; };
+        inline const double&      GetStreamPeriod()       const { return stream_period_; };
+
+        // Mailbox to write the joint commands to, if the transport is in_process.
+        inline Mailbox<JointCommand>& GetCommandBuffer() { return *commands_; };
+
+        // Mailbox to write trajectory segments to, if the transport is in_process.
+        inline Mailbox<JointSegment>& GetSegmentBuffer() { return *segments_; };
 
     private:
 
         // Methods to be implemented for RateThread.
+        virtual bool threadInit();
+
         virtual void run();
 
+        virtual void threadRelease();
+
         // Implement methods for writing to YARP ports.
         void UnsetDrivers();
         
@@ -39,6 +58,9 @@ class WriteJoints : public yarp::os::RateThread
 
         bool SetControlModes(int mode);
 
+        // Fit the spline from the current reference through the future knots of joint_segment_.
+        void SetSpline(double now);
+
         // Robot.
         const std::string robot_name_;
 
@@ -56,6 +78,7 @@ class WriteJoints : public yarp::os::RateThread
 
         // Moving to the initial position.
         RobotStatus robot_status_;
+        double t_check_;
         double initial_vel_;
 
         // Port to communicate initial position status.
@@ -67,6 +90,35 @@ class WriteJoints : public yarp::os::RateThread
         // Port to read joint angles from.
         std::string port_name_;
         yarp::os::BufferedPort<yarp::sig::Vector> port_;
+
+        // In-process transport.
+        std::string transport_;
+        JointCommand joint_command_;
+        std::unique_ptr<Mailbox<JointCommand>> commands_;
+
+        // Trajectory segments, which are streamed every stream_period with a cubic
+        // spline. A stream_period of 0 writes the commands as they arrive.
+        double stream_period_;
+        std::string segment_port_name_;
+        yarp::os::BufferedPort<yarp::sig::Matrix> port_segment_;
+
+        JointSegment joint_segment_;
+        std::unique_ptr<Mailbox<JointSegment>> segments_;
+
+        CubicSpline spline_;
+        Eigen::VectorXd knot_t_;
+        Eigen::MatrixXd knot_q_;
+        Eigen::VectorXd q_stream_;
+        Eigen::VectorXd dq_stream_;
+        Eigen::VectorXd dq_end_;
+
+        // Tick statistics, published on a port every stats_interval_ seconds.
+        TickStatistics stats_;
+        double stats_interval_;
+        yarp::os::BufferedPort<yarp::os::Bottle> port_stats_;
+
+        // Heartbeat, to signal that this thread is alive.
+        Heartbeat heartbeat_;
 };
 
 #endif
\ No newline at end of file
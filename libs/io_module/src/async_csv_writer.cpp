@@ -0,0 +1,86 @@
+#include "async_csv_writer.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+
+// Implement AsyncCsvWriter.
+AsyncCsvWriter::AsyncCsvWriter(const std::string& path, int cols, size_t capacity)
+  : cols_(cols),
+    file_(path.c_str()),
+    rows_(capacity, Eigen::VectorXd::Zero(cols)),
+    row_(Eigen::VectorXd::Zero(cols)),
+    running_(true),
+    written_(0),
+    dropped_(0) {
+
+    if (!file_.is_open()) {
+        std::cerr << "Could not open " << path << " for writing." << std::endl;
+        std::exit(1);
+    }
+
+    thread_ = std::thread(&AsyncCsvWriter::Run, this);
+}
+
+
+AsyncCsvWriter::~AsyncCsvWriter() {
+
+    Close();
+}
+
+
+bool AsyncCsvWriter::Push(const Eigen::Ref<const Eigen::VectorXd>& row) {
+
+    // The row is copied into the preallocated slot, without allocation.
+    row_ = row;
+
+    if (!rows_.Push(row_)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+
+void AsyncCsvWriter::Close() {
+
+    running_ = false;
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    file_.close();
+}
+
+
+void AsyncCsvWriter::Run() {
+
+    Eigen::VectorXd row = Eigen::VectorXd::Zero(cols_);
+
+    // Drain the buffer, also after stopping. The flag is read before popping,
+    // so that rows pushed before Close() are never lost.
+    while (true) {
+
+        bool stop = !running_;
+
+        if (rows_.Pop(row)) {
+
+            for (int i = 0; i < row.size(); i++) {
+                file_ << row(i) << (i < row.size() - 1 ? ", " : "\n");
+            }
+
+            written_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (stop) {
+            break;
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    file_.flush();
+}
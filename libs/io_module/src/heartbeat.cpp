@@ -0,0 +1,128 @@
+#include "heartbeat.h"
+
+#include <iostream>
+
+
+// Implement Heartbeat.
+Heartbeat::Heartbeat(const std::string& port_name, double period)
+  : RateThread(period*1e3),
+    port_name_(port_name),
+    period_(period),
+    last_(-period),
+    count_(0) {
+
+    port_.open(port_name_);
+}
+
+
+Heartbeat::~Heartbeat() {
+
+    port_.close();
+}
+
+
+void Heartbeat::Beat() {
+
+    double now = yarp::os::Time::now();
+
+    if (now - last_ < period_) {
+        return;
+    }
+
+    last_ = now;
+
+    yarp::os::Bottle& beat = port_.prepare();
+    beat.clear();
+    beat.addInt(count_++);
+    beat.addDouble(now);
+    port_.write();
+}
+
+
+// Implement Watchdog.
+Watchdog::Watchdog(const std::string& name, double period, double timeout, double grace)
+  : RateThread(period*1e3),
+    name_(name),
+    timeout_(timeout),
+    grace_(grace),
+    start_(0.),
+    estop_(false) {   }
+
+
+Watchdog::~Watchdog() {
+
+    if (isRunning()) {
+        stop();
+    }
+}
+
+
+void Watchdog::Watch(const std::string& source) {
+
+    monitors_.emplace_back(new Monitor(source, "/" + name_ + "/watchdog" + source));
+}
+
+
+void Watchdog::Trigger(const std::string& reason) {
+
+    if (!estop_.exchange(true, std::memory_order_acq_rel)) {
+        std::cout << "Emergency stop: " << reason << "." << std::endl;
+    }
+}
+
+
+bool Watchdog::threadInit() {
+
+    start_ = yarp::os::Time::now();
+
+    return true;
+}
+
+
+void Watchdog::run() {
+
+    double now = yarp::os::Time::now();
+
+    for (auto& monitor : monitors_) {
+
+        double last = monitor->last.load(std::memory_order_acquire);
+
+        if (last < 0.) {
+
+            // Keep connecting, until the source is up. This runs off the control path.
+            if (now - start_ > grace_) {
+                Trigger("no heartbeat from " + monitor->source);
+            }
+            else {
+                yarp::os::Network::connect(monitor->source, monitor->local);
+            }
+        }
+        else if (now - last > timeout_) {
+
+            Trigger("heartbeat of " + monitor->source + " missing for " + std::to_string(now - last) + " s");
+        }
+    }
+}
+
+
+Watchdog::Monitor::Monitor(const std::string& source, const std::string& local)
+  : source(source),
+    local(local),
+    last(-1.) {
+
+    port.useCallback(*this);
+    port.open(local);
+}
+
+
+Watchdog::Monitor::~Monitor() {
+
+    port.close();
+}
+
+
+void Watchdog::Monitor::onRead(yarp::os::Bottle& beat) {
+
+    // The time of arrival, so that the clocks of sender and watchdog need not agree.
+    last.store(yarp::os::Time::now(), std::memory_order_release);
+}
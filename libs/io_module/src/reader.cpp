@@ -1,10 +1,19 @@
 #include "reader.h"
 
+#include <algorithm>
+#include <cstring>
+
 ReadJoints::ReadJoints(int period, const std::string config_file_loc, 
                        const std::string robot_name)
   : RateThread(period),
     robot_name_(robot_name),
-    configs_(YAML::LoadFile(config_file_loc)) {
+    configs_(YAML::LoadFile(config_file_loc)),
+
+    // Tick statistics.
+    stats_("read_joints", period*1e-3, configs_["stats_bin"].as<double>(), configs_["stats_bins"].as<int>(), configs_["stats_miss_tol"].as<double>()),
+
+    // Heartbeat.
+    heartbeat_("/read_joints/heartbeat", configs_["heartbeat_period"].as<double>()) {
 
     // Set configurations and drivers.
     SetConfigs();
@@ -24,12 +33,18 @@ ReadJoints::ReadJoints(int period, const std::string config_file_loc,
     // Read extremal joint angles from the robot.
     ReadLimits();  
 
+    // Preallocate the in-process transport.
+    joint_state_ = JointState{0., Eigen::MatrixXd::Zero(joints, 3)};
+    states_.reset(new Mailbox<JointState>(joint_state_));
+
     // Open port to write to.
     port_.open(port_name_);
     
     if (port_.isClosed()) {
         std::cerr << "Could not open port " << port_name_ << std::endl;
     }
+
+    port_stats_.open("/read_joints/stats");
 }
 
 
@@ -40,11 +55,23 @@ ReadJoints::~ReadJoints() {
 
     // Close ports.
     port_.close();
+    port_stats_.close();
+}
+
+
+bool ReadJoints::threadInit() {
+
+    // Scheduling, affinity and memory of this thread.
+    SetRealtime(ReadRealtimeConfigs(configs_, "read_joints"), "read_joints");
+
+    return true;
 }
 
 
 void ReadJoints::run() {
 
+    stats_.Start();
+
     bool ok = true;
     int count = 0;
 
@@ -79,10 +106,39 @@ void ReadJoints::run() {
         std::exit(1);
     }
 
-    // Send read data to a port.
-    yarp::sig::Matrix& data = port_.prepare();
-    data =   state_;
-    port_.write();    
+    // Time stamp of the state.
+    stamp_.update();
+
+    if (transport_ == "in_process") {
+
+        // Hand the state over to the consumer in this process, without serialization.
+        // A state, which the consumer has not taken yet, is overwritten by the new one.
+        joint_state_.time = stamp_.getTime();
+        joint_state_.state = yarp::eigen::toEigen(state_);
+        states_->Push(joint_state_);
+    }
+
+    // Send read data to a port. For the in-process transport, only if
+    // another process is listening.
+    if (transport_ != "in_process" || port_.getOutputCount() > 0) {
+
+        yarp::sig::Matrix& data = port_.prepare();
+        data =   state_;
+        port_.setEnvelope(stamp_);
+        port_.write();
+    }
+
+    heartbeat_.Beat();
+
+    stats_.Stop();
+    stats_.Publish(port_stats_, stats_interval_);
+}
+
+
+void ReadJoints::threadRelease() {
+
+    // Dump the tick statistics.
+    stats_.Print();
 }
 
 
@@ -116,6 +172,12 @@ void ReadJoints::SetConfigs() {
 
     // Check for the joints port name to write to.
     port_name_ = configs_["joints_port_read"].as<std::string>();
+
+    // Check for the transport to the consumer.
+    transport_ = configs_["transport"].as<std::string>();
+
+    // Check for the interval of the tick statistics.
+    stats_interval_ = configs_["stats_interval"].as<double>();
 }
 
 
@@ -197,7 +259,11 @@ ReadCameras::ReadCameras(int period, const std::string config_file_loc,
   : RateThread(period),
     robot_name_(robot_name),
     period_(period),
-    configs_(YAML::LoadFile(config_file_loc)) {
+    configs_(YAML::LoadFile(config_file_loc)),
+    ticks_(0),
+
+    // Tick statistics.
+    stats_("read_cameras", period*1e-3, configs_["stats_bin"].as<double>(), configs_["stats_bins"].as<int>(), configs_["stats_miss_tol"].as<double>()) {
 
     // Set configurations and drivers.
     SetConfigs();
@@ -208,8 +274,13 @@ ReadCameras::ReadCameras(int period, const std::string config_file_loc,
         for (const auto& camera : part.cameras) {
 
             ports_[camera].open("/read_cameras/" + camera);
+
+            // Shared memory is created once the size of the first image is known.
+            rings_[camera].reset(new SharedImageRing("/read_cameras_" + camera));
         }
     }
+
+    port_stats_.open("/read_cameras/stats");
 }
 
 
@@ -223,24 +294,152 @@ ReadCameras::~ReadCameras() {
         }
     }
 
+    port_stats_.close();
+
     // Unset drivers.
     UnsetDrivers();
 }
 
 
+bool ReadCameras::threadInit() {
+
+    // Keep the cameras away from the cores of the control threads.
+    SetRealtime(ReadRealtimeConfigs(configs_, "read_cameras"), "read_cameras");
+
+    return true;
+}
+
+
 void ReadCameras::run() {
 
+    stats_.Start();
+
     // Read the camera every period_ ms.
     for (const auto& part : parts_) {
         for (const auto& camera : part.cameras) {
+
+            // Skip decimated frames, without grabbing them.
+            if (ticks_ % outputs_[camera].decimation != 0) {
+                continue;
+            }
+
             grab_[camera]->getImage(imgs_[camera]);
 
-            // Write image to port.
-            yarp::sig::ImageOf<yarp::sig::PixelRgb>& img = ports_[camera].prepare();
-            img = imgs_[camera];
-            ports_[camera].write();
+            int width, height, channels;
+            OutputSize(imgs_[camera], outputs_[camera], width, height, channels);
+
+            // Process the image straight into shared memory for consumers on this host.
+            if (shared_images_) {
+
+                if (!rings_[camera]->IsOpen()) {
+                    rings_[camera]->Create(configs_["shared_images_slots"].as<int>(), width*height*channels);
+                }
+
+                unsigned char* data = rings_[camera]->BeginWrite(width, height, channels);
+
+                if (data != YARP_NULLPTR) {
+                    ProcessImage(imgs_[camera], outputs_[camera], data, width*channels);
+                    rings_[camera]->EndWrite(yarp::os::Time::now());
+                }
+            }
+
+            // Process and write image to port, only if someone listens when shared memory is used.
+            if (!shared_images_ || ports_[camera].getOutputCount() > 0) {
+
+                yarp::sig::FlexImage& img = ports_[camera].prepare();
+                img.setPixelCode(channels == 1 ? VOCAB_PIXEL_MONO : VOCAB_PIXEL_RGB);
+                img.resize(width, height);
+
+                ProcessImage(imgs_[camera], outputs_[camera], img.getRawImage(), img.getRowSize());
+                ports_[camera].write();
+            }
         }
     } 
+
+    ticks_++;
+
+    stats_.Stop();
+    stats_.Publish(port_stats_, stats_interval_);
+}
+
+
+void ReadCameras::threadRelease() {
+
+    // Dump the tick statistics.
+    stats_.Print();
+}
+
+
+void ReadCameras::Roi(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& in, const CameraOutput& out, int& x0, int& y0, int& w, int& h) {
+
+    // Region of interest, clamped to the image.
+    x0 = 0;
+    y0 = 0;
+    w = in.width();
+    h = in.height();
+
+    if (out.roi.size() == 4) {
+        x0 = std::min(std::max(out.roi[0], 0), int(in.width()) - 1);
+        y0 = std::min(std::max(out.roi[1], 0), int(in.height()) - 1);
+        w = std::min(out.roi[2], int(in.width()) - x0);
+        h = std::min(out.roi[3], int(in.height()) - y0);
+    }
+}
+
+
+void ReadCameras::OutputSize(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& in, const CameraOutput& out, int& width, int& height, int& channels) {
+
+    int x0, y0, w, h;
+    Roi(in, out, x0, y0, w, h);
+
+    width = out.width > 0 ? out.width : w;
+    height = out.height > 0 ? out.height : h;
+    channels = out.grayscale ? 1 : 3;
+}
+
+
+void ReadCameras::ProcessImage(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& in, const CameraOutput& out, unsigned char* data, size_t row_size) {
+
+    int x0, y0, w, h;
+    Roi(in, out, x0, y0, w, h);
+
+    // Output size.
+    int ow, oh, channels;
+    OutputSize(in, out, ow, oh, channels);
+
+    // Nearest neighbour sampling of the region of interest.
+    const unsigned char* src = in.getRawImage();
+    const size_t src_row = in.getRowSize();
+
+    for (int y = 0; y < oh; y++) {
+
+        const unsigned char* src_row_ptr = src + (y0 + y*h/oh)*src_row;
+        unsigned char* dst = data + y*row_size;
+
+        if (!out.grayscale && ow == w) {
+
+            // Plain crop.
+            std::memcpy(dst, src_row_ptr + 3*x0, 3*w);
+            continue;
+        }
+
+        for (int x = 0; x < ow; x++) {
+
+            const unsigned char* p = src_row_ptr + 3*(x0 + x*w/ow);
+
+            if (out.grayscale) {
+
+                // Luma, ITU-R BT.601.
+                dst[x] = (unsigned char)((77*p[0] + 150*p[1] + 29*p[2]) >> 8);
+            }
+            else {
+
+                dst[3*x + 0] = p[0];
+                dst[3*x + 1] = p[1];
+                dst[3*x + 2] = p[2];
+            }
+        }
+    }
 }
 
 
@@ -275,6 +474,43 @@ void ReadCameras::SetConfigs() {
                                   (*part)["cameras"].as<std::vector<std::string>>()});
         }
     }
+
+    // Check for the shared memory transport.
+    shared_images_ = configs_["shared_images"].as<bool>();
+
+    // Check for the interval of the tick statistics.
+    stats_interval_ = configs_["stats_interval"].as<double>();
+
+    // Check for the processing of every camera, cameras without entry are published unchanged.
+    for (const auto& part : parts_) {
+        for (const auto& camera : part.cameras) {
+
+            outputs_[camera] = CameraOutput{std::vector<int>(), 0, 0, false, 1};
+
+            const YAML::Node out = configs_["camera_output"][camera];
+
+            if (out) {
+                outputs_[camera] = CameraOutput{out["roi"].as<std::vector<int>>(),
+                                                out["width"].as<int>(),
+                                                out["height"].as<int>(),
+                                                out["grayscale"].as<bool>(),
+                                                std::max(out["decimation"].as<int>(), 1)};
+            }
+
+            // The region of interest is empty for the whole image, or x, y, width and height within it.
+            const CameraOutput& o = outputs_[camera];
+
+            if (!o.roi.empty() && (o.roi.size() != 4 || o.roi[0] < 0 || o.roi[1] < 0 || o.roi[2] <= 0 || o.roi[3] <= 0)) {
+                std::cerr << "Region of interest of camera " << camera << " needs x >= 0, y >= 0, width > 0 and height > 0." << std::endl;
+                std::exit(1);
+            }
+
+            if (o.width < 0 || o.height < 0) {
+                std::cerr << "Output size of camera " << camera << " needs width >= 0 and height >= 0." << std::endl;
+                std::exit(1);
+            }
+        }
+    }
 }
 
 
@@ -312,6 +548,15 @@ void ReadCameras::SetDrivers() {
                 std::cout << "Problems acquiring interfaces" << std::endl;
                 std::exit(1);
             }
+
+            // The region of interest has to lie within the image.
+            const std::vector<int>& roi = outputs_[camera].roi;
+
+            if (roi.size() == 4 && (roi[0] + roi[2] > f->width() || roi[1] + roi[3] > f->height())) {
+                std::cerr << "Region of interest of camera " << camera << " exceeds the image of "
+                          << f->width() << "x" << f->height() << "." << std::endl;
+                std::exit(1);
+            }
         }
     }
 }
@@ -323,13 +568,17 @@ AppReader::AppReader(bool simulation)
       robot_status_(NOT_CONNECTED),
       errors_(NO_ERRORS),
       warnings_(NO_WARNINGS),
-      vel_(3) {
+      vel_(3),
+      heartbeat_("/user_interface/heartbeat") {
 
     // Open ports.
     port_vel_app_.open("/vel/read_from_app");
     port_vel_.open("/reader/vel");
     port_status_.open("/reader/robot_status");
 
+    // Signal the pattern generator that the user interface is alive.
+    heartbeat_.start();
+
     // Set velocity to zero.
     vel_.zero();
 
@@ -409,6 +658,7 @@ AppReader::~AppReader() {
 
     this->interrupt(); // interrupt any communication
     this->close();
+    heartbeat_.stop();
 
     // Set velocity to zero before closing.
     vel_.zero();
@@ -707,6 +957,7 @@ void AppReader::ReadCommands() {
             running_ = false;
             this->interrupt(); // interrupt any communication
             this->close();
+            heartbeat_.stop();
 
             // Set red colours.
             wbkgd(win_r_, COLOR_PAIR(3));
@@ -761,13 +1012,17 @@ KeyReader::KeyReader(bool simulation, std::string mode)
       acc_s_(-1., 0., 0.),
       acc_d_( 0. , 0., -1.),
       acc_shift_d_(0., -0.1, 0.),
-      vel_(3) {
+      vel_(3),
+      heartbeat_("/user_interface/heartbeat") {
 
     // Open port.
     port_.open("/reader/vel");
     port_status_.open("/reader/robot_status");
     port_epoch_.open("/reader/epoch");
 
+    // Signal the pattern generator that the user interface is alive.
+    heartbeat_.start();
+
     epoch_ = 58;
 
     // Set velocity to zero.
@@ -867,6 +1122,7 @@ KeyReader::~KeyReader() {
 
     this->interrupt(); // interrupt any communication
     this->close();
+    heartbeat_.stop();
 
     // Set velocity to zero before closing.
     vel_.zero();
@@ -1082,6 +1338,7 @@ void KeyReader::ReadCommands() {
                     running_ = false;
                     this->interrupt(); // interrupt any communication
                     this->close();
+                    heartbeat_.stop();
 
                     // Set red colour.
                     wclear(win_hello_);
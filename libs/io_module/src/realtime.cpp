@@ -0,0 +1,128 @@
+#include "realtime.h"
+
+#include <alloca.h>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+RealtimeConfigs ReadRealtimeConfigs(const YAML::Node& configs, const std::string& thread) {
+
+    RealtimeConfigs rt{0, std::vector<int>(), false, 0};
+
+    if (!configs["realtime"]) {
+        return rt;
+    }
+
+    rt.lock_memory = configs["realtime"]["lock_memory"].as<bool>();
+
+    const YAML::Node node = configs["realtime"][thread];
+
+    if (node) {
+
+        if (node["priority"]) {
+            rt.priority = node["priority"].as<int>();
+        }
+        if (node["cpus"]) {
+            rt.cpus = node["cpus"].as<std::vector<int>>();
+        }
+        if (node["prefault_stack"]) {
+            rt.prefault_stack = node["prefault_stack"].as<int>();
+        }
+    }
+
+    return rt;
+}
+
+
+// Touch the stack, so that its pages are mapped before the thread runs.
+static void PrefaultStack(int size) {
+
+    volatile char* stack = static_cast<volatile char*>(alloca(size));
+
+    for (int i = 0; i < size; i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+
+void SetRealtime(const RealtimeConfigs& configs, const std::string& thread) {
+
+    std::stringstream report;
+    report << thread << ":";
+
+    // Memory locking, applies to the whole process, so it is only done by the first thread.
+    static std::once_flag lock_memory;
+
+    if (configs.lock_memory) {
+
+        std::call_once(lock_memory, [&report]() {
+
+            if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+                report << " memory not locked (" << std::strerror(errno) << "),";
+            }
+            else {
+                report << " memory locked,";
+            }
+        });
+    }
+
+    if (configs.prefault_stack > 0) {
+
+        PrefaultStack(configs.prefault_stack);
+        report << " " << configs.prefault_stack/1024 << " kB stack prefaulted,";
+    }
+
+    // Scheduler.
+    if (configs.priority > 0) {
+
+        sched_param param;
+        param.sched_priority = configs.priority;
+
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+        if (err != 0) {
+            report << " SCHED_FIFO " << configs.priority << " denied (" << std::strerror(err) << "),";
+        }
+    }
+
+    // Affinity.
+    if (!configs.cpus.empty()) {
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        for (const auto& cpu : configs.cpus) {
+            CPU_SET(cpu, &set);
+        }
+
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+
+        if (err != 0) {
+            report << " affinity denied (" << std::strerror(err) << "),";
+        }
+    }
+
+    // Report what was granted.
+    int policy;
+    sched_param param;
+    pthread_getschedparam(pthread_self(), &policy, &param);
+
+    report << " granted " << (policy == SCHED_FIFO ? "SCHED_FIFO" : policy == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER")
+           << " priority " << param.sched_priority << ", cpus";
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            report << " " << cpu;
+        }
+    }
+
+    std::cout << report.str() << std::endl;
+}
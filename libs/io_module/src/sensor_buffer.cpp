@@ -0,0 +1,140 @@
+#include "sensor_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+
+// Implement SensorBuffer.
+SensorBuffer::SensorBuffer(size_t capacity, int dim)
+  : capacity_(std::max(capacity, size_t(1))),
+    dim_(dim),
+    samples_(Eigen::MatrixXd::Zero(dim, std::max(capacity, size_t(1)))),
+    times_(std::max(capacity, size_t(1)), 0.),
+    head_(0),
+    size_(0) {   }
+
+
+SensorBuffer::~SensorBuffer() {
+
+    Close();
+}
+
+
+bool SensorBuffer::Open(const std::string& name) {
+
+    name_ = name;
+
+    port_.useCallback(*this);
+
+    return port_.open(name_);
+}
+
+
+void SensorBuffer::SetStrict(bool strict) {
+
+    port_.setStrict(strict);
+}
+
+
+void SensorBuffer::Close() {
+
+    if (!port_.isClosed()) {
+        port_.close();
+    }
+}
+
+
+void SensorBuffer::onRead(yarp::sig::Vector& sample) {
+
+    if (sample.size() != size_t(dim_)) {
+        std::cerr << "Sample on " << name_ << " has " << sample.size() << " entries, expected " << dim_ << "." << std::endl;
+        return;
+    }
+
+    // Prefer the time stamp of the sender.
+    yarp::os::Stamp stamp;
+    double time = port_.getEnvelope(stamp) && stamp.isValid() ? stamp.getTime() : yarp::os::Time::now();
+
+    Push(time, yarp::eigen::toEigen(sample));
+}
+
+
+void SensorBuffer::Push(double time, const Eigen::Ref<const Eigen::VectorXd>& sample) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Keep the time stamps ordered, also if the sender's clock steps back.
+    if (size_ > 0) {
+        time = std::max(time, times_[Slot(size_ - 1)]);
+    }
+
+    samples_.col(head_) = sample;
+    times_[head_] = time;
+
+    head_ = (head_ + 1) % capacity_;
+    size_ = std::min(size_ + 1, capacity_);
+}
+
+
+bool SensorBuffer::Align(double time, Eigen::Ref<Eigen::VectorXd> sample, double* dt) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (size_ == 0) {
+        return false;
+    }
+
+    // First sample later than time.
+    size_t lo = 0;
+    size_t hi = size_;
+
+    while (lo < hi) {
+
+        size_t mid = (lo + hi)/2;
+
+        if (times_[Slot(mid)] <= time) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    if (lo == 0 || lo == size_) {
+
+        // Outside the buffered range.
+        size_t s = Slot(lo == 0 ? 0 : size_ - 1);
+        sample = samples_.col(s);
+
+        if (dt != YARP_NULLPTR) {
+            *dt = std::abs(times_[s] - time);
+        }
+
+        return true;
+    }
+
+    // Linear interpolation between the samples around time.
+    size_t s0 = Slot(lo - 1);
+    size_t s1 = Slot(lo);
+
+    double t0 = times_[s0];
+    double t1 = times_[s1];
+    double a = t1 > t0 ? (time - t0)/(t1 - t0) : 1.;
+
+    sample = (1. - a)*samples_.col(s0) + a*samples_.col(s1);
+
+    if (dt != YARP_NULLPTR) {
+        *dt = std::min(time - t0, t1 - time);
+    }
+
+    return true;
+}
+
+
+size_t SensorBuffer::GetSize() {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return size_;
+}
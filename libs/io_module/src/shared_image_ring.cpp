@@ -0,0 +1,252 @@
+#include "shared_image_ring.h"
+
+#include <cmath>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Identification of the shared memory.
+const static uint32_t kMagic = 0x53495247; // SIRG
+
+// Round up to full cache lines.
+static size_t Align(size_t size) {
+    return (size + 63)/64*64;
+}
+
+
+SharedImageRing::SharedImageRing(const std::string& name)
+  : name_(name),
+    owner_(false),
+    base_(nullptr),
+    size_(0),
+    header_(nullptr),
+    data_offset_(Align(sizeof(Header))),
+    slot_header_(Align(sizeof(Slot))),
+    writing_(-1) {   }
+
+
+SharedImageRing::~SharedImageRing() {
+
+    Close();
+}
+
+
+bool SharedImageRing::Create(int slots, size_t slot_size) {
+
+    Close();
+
+    // Replace stale memory of a previous producer.
+    shm_unlink(name_.c_str());
+
+    int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR, 0666);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    const size_t stride = Align(slot_header_ + slot_size);
+    size_ = data_offset_ + slots*stride;
+
+    if (ftruncate(fd, size_) != 0) {
+        close(fd);
+        shm_unlink(name_.c_str());
+        return false;
+    }
+
+    void* base = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        shm_unlink(name_.c_str());
+        return false;
+    }
+
+    base_ = static_cast<unsigned char*>(base);
+    owner_ = true;
+
+    // Initialize the header and the slots, the magic number is set last.
+    header_ = reinterpret_cast<Header*>(base_);
+    header_->slots = slots;
+    header_->slot_size = slot_size;
+    header_->slot_stride = stride;
+    new (&header_->written) std::atomic<uint64_t>(0);
+
+    for (int i = 0; i < slots; i++) {
+        new (&GetSlot(i)->seq) std::atomic<uint64_t>(0);
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = kMagic;
+
+    return true;
+}
+
+
+unsigned char* SharedImageRing::BeginWrite(int width, int height, int channels) {
+
+    if (!owner_ || size_t(width)*height*channels > header_->slot_size) {
+        return nullptr;
+    }
+
+    // Overwrite the oldest slot, and mark it as being written.
+    writing_ = header_->written.load(std::memory_order_relaxed) % header_->slots;
+
+    Slot* slot = GetSlot(writing_);
+
+    slot->seq.store(slot->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->width = width;
+    slot->height = height;
+    slot->channels = channels;
+
+    return GetData(writing_);
+}
+
+
+void SharedImageRing::EndWrite(double time) {
+
+    if (writing_ < 0) {
+        return;
+    }
+
+    Slot* slot = GetSlot(writing_);
+    slot->time = time;
+
+    // Publish the slot.
+    slot->seq.store(slot->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    header_->written.fetch_add(1, std::memory_order_release);
+
+    writing_ = -1;
+}
+
+
+bool SharedImageRing::Open() {
+
+    if (IsOpen()) {
+        return true;
+    }
+
+    int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    // The size is known from the file, the layout from the header.
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < data_offset_) {
+        close(fd);
+        return false;
+    }
+
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    base_ = static_cast<unsigned char*>(base);
+    size_ = st.st_size;
+    header_ = reinterpret_cast<Header*>(base_);
+
+    // The producer may not have finished the initialization yet.
+    if (header_->magic != kMagic) {
+        Close();
+        return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return true;
+}
+
+
+bool SharedImageRing::ReadSlot(int i, SharedFrame& frame) const {
+
+    const Slot* slot = GetSlot(i);
+    uint64_t seq = slot->seq.load(std::memory_order_acquire);
+
+    // Being written, or never written.
+    if (seq % 2 == 1 || seq == 0) {
+        return false;
+    }
+
+    // The slots are written in turn, so the writes to this slot give the frames of the ring.
+    frame.seq = seq;
+    frame.written = (seq/2 - 1)*header_->slots + i + 1;
+    frame.slot = i;
+    frame.time = slot->time;
+    frame.width = slot->width;
+    frame.height = slot->height;
+    frame.channels = slot->channels;
+    frame.data = GetData(i);
+
+    return Valid(frame);
+}
+
+
+bool SharedImageRing::ReadLatest(SharedFrame& frame) const {
+
+    if (!IsOpen()) {
+        return false;
+    }
+
+    uint64_t written = header_->written.load(std::memory_order_acquire);
+
+    if (written == 0) {
+        return false;
+    }
+
+    return ReadSlot((written - 1) % header_->slots, frame);
+}
+
+
+bool SharedImageRing::ReadClosest(double time, SharedFrame& frame) const {
+
+    if (!IsOpen()) {
+        return false;
+    }
+
+    bool found = false;
+    SharedFrame candidate;
+
+    for (uint32_t i = 0; i < header_->slots; i++) {
+
+        if (ReadSlot(i, candidate) && (!found || std::abs(candidate.time - time) < std::abs(frame.time - time))) {
+            frame = candidate;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+
+bool SharedImageRing::Valid(const SharedFrame& frame) const {
+
+    // Everything read before has to happen before the sequence number is checked again.
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return GetSlot(frame.slot)->seq.load(std::memory_order_relaxed) == frame.seq;
+}
+
+
+void SharedImageRing::Close() {
+
+    if (base_ != nullptr) {
+        munmap(base_, size_);
+    }
+
+    if (owner_) {
+        shm_unlink(name_.c_str());
+    }
+
+    base_ = nullptr;
+    header_ = nullptr;
+    owner_ = false;
+}
@@ -0,0 +1,90 @@
+#include "spline.h"
+
+#include <algorithm>
+
+
+// Implement CubicSpline.
+CubicSpline::CubicSpline() {   }
+
+
+void CubicSpline::Fit(const Eigen::Ref<const Eigen::VectorXd>& t,
+                      const Eigen::Ref<const Eigen::MatrixXd>& y,
+                      const Eigen::Ref<const Eigen::VectorXd>& v0,
+                      const Eigen::Ref<const Eigen::VectorXd>& v1) {
+
+    const int n = t.size();
+
+    t_ = t;
+    y_ = y;
+    m_.resize(y.rows(), n);
+
+    if (n < 2) {
+        return;
+    }
+
+    c_.resize(n);
+    d_.resize(y.rows(), n);
+
+    // Solve for the second derivatives m with the Thomas algorithm. The
+    // matrix only depends on the times, so all signals are solved at once.
+    //   h_{i-1} m_{i-1} + 2 (h_{i-1} + h_i) m_i + h_i m_{i+1} = 6 (s_i - s_{i-1})
+    // with the slopes s_i = (y_{i+1} - y_i)/h_i, and at the ends
+    //   2 h_0 m_0 + h_0 m_1 = 6 (s_0 - v0),  h_{n-2} m_{n-2} + 2 h_{n-2} m_{n-1} = 6 (v1 - s_{n-2}).
+    double h = t(1) - t(0);
+    double b = 2.*h;
+
+    c_(0) = h/b;
+    d_.col(0) = 6.*((y.col(1) - y.col(0))/h - v0)/b;
+
+    for (int i = 1; i < n; i++) {
+
+        double h_prev = t(i) - t(i - 1);
+
+        if (i < n - 1) {
+            h = t(i + 1) - t(i);
+            b = 2.*(h_prev + h) - h_prev*c_(i - 1);
+            c_(i) = h/b;
+            d_.col(i) = (6.*((y.col(i + 1) - y.col(i))/h - (y.col(i) - y.col(i - 1))/h_prev) - h_prev*d_.col(i - 1))/b;
+        }
+        else {
+            b = 2.*h_prev - h_prev*c_(i - 1);
+            d_.col(i) = (6.*(v1 - (y.col(i) - y.col(i - 1))/h_prev) - h_prev*d_.col(i - 1))/b;
+        }
+    }
+
+    m_.col(n - 1) = d_.col(n - 1);
+
+    for (int i = n - 2; i >= 0; i--) {
+        m_.col(i) = d_.col(i) - c_(i)*m_.col(i + 1);
+    }
+}
+
+
+void CubicSpline::Evaluate(double t, Eigen::Ref<Eigen::VectorXd> y, Eigen::Ref<Eigen::VectorXd> dy) const {
+
+    const int n = t_.size();
+
+    // Hold the values outside of the knots.
+    if (n < 2 || t <= t_(0)) {
+        if (n > 0) {
+            y = y_.col(0);
+        }
+        dy.setZero();
+        return;
+    }
+    if (t >= t_(n - 1)) {
+        y = y_.col(n - 1);
+        dy.setZero();
+        return;
+    }
+
+    // Interval, that contains t.
+    int i = std::upper_bound(t_.data(), t_.data() + n, t) - t_.data() - 1;
+
+    double h = t_(i + 1) - t_(i);
+    double a = (t_(i + 1) - t)/h;
+    double b = (t - t_(i))/h;
+
+    y = a*y_.col(i) + b*y_.col(i + 1) + ((a*a*a - a)*m_.col(i) + (b*b*b - b)*m_.col(i + 1))*h*h/6.;
+    dy = (y_.col(i + 1) - y_.col(i))/h + (-(3.*a*a - 1.)*m_.col(i) + (3.*b*b - 1.)*m_.col(i + 1))*h/6.;
+}
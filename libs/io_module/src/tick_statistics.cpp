@@ -0,0 +1,171 @@
+#include "tick_statistics.h"
+
+#include <algorithm>
+
+Histogram::Histogram(double bin, int bins)
+  : bin_(bin),
+    bins_(std::max(bins, 1)),
+    hist_(new std::atomic<uint64_t>[std::max(bins, 1)]),
+    count_(0),
+    sum_(0),
+    max_(0) {
+
+    for (int i = 0; i < bins_; i++) {
+        hist_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+
+void Histogram::Add(double value) {
+
+    int i = std::min(int(std::max(value, 0.)/bin_), bins_ - 1);
+    uint64_t ns = uint64_t(std::max(value, 0.)*1e9);
+
+    hist_[i].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(ns, std::memory_order_relaxed);
+
+    // Maximum without locks.
+    uint64_t max = max_.load(std::memory_order_relaxed);
+
+    while (ns > max && !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) { }
+}
+
+
+double Histogram::GetMean() const {
+
+    uint64_t count = GetCount();
+
+    return count == 0 ? 0. : 1e-9*sum_.load(std::memory_order_relaxed)/count;
+}
+
+
+double Histogram::GetMax() const {
+
+    return 1e-9*max_.load(std::memory_order_relaxed);
+}
+
+
+double Histogram::GetPercentile(double p) const {
+
+    uint64_t count = GetCount();
+    uint64_t sum = 0;
+
+    for (int i = 0; i < bins_; i++) {
+
+        sum += GetHist(i);
+
+        if (sum >= p*count) {
+            return (i + 1)*bin_;
+        }
+    }
+
+    return bins_*bin_;
+}
+
+
+TickStatistics::TickStatistics(const std::string& name, double period, double bin, int bins, double miss_tol)
+  : name_(name),
+    period_(period),
+    miss_tol_(miss_tol),
+    period_hist_(bin, bins),
+    duration_hist_(bin, bins),
+    misses_(0),
+    started_(false),
+    last_period_(period),
+    published_(0.) {   }
+
+
+void TickStatistics::Start() {
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (started_) {
+        last_period_ = std::chrono::duration<double>(now - start_).count();
+    }
+
+    start_ = now;
+}
+
+
+void TickStatistics::Stop() {
+
+    double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+
+    // The first tick has no period.
+    if (started_) {
+        Record(last_period_, duration);
+    }
+    else {
+        duration_hist_.Add(duration);
+        misses_.fetch_add(duration > period_, std::memory_order_relaxed);
+        started_ = true;
+    }
+}
+
+
+void TickStatistics::Record(double period, double duration) {
+
+    period_hist_.Add(period);
+    duration_hist_.Add(duration);
+
+    // A tick misses its deadline, if it started too late, or ran longer than the period.
+    if (period > (1. + miss_tol_)*period_ || duration > period_) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+void TickStatistics::Write(yarp::os::Bottle& bottle) const {
+
+    yarp::os::Property& dict = bottle.addDict();
+
+    dict.put("name", name_);
+    dict.put("ticks", int(duration_hist_.GetCount()));
+    dict.put("misses", int(GetMisses()));
+    dict.put("period_mean", period_hist_.GetMean());
+    dict.put("period_max", period_hist_.GetMax());
+    dict.put("period_p99", period_hist_.GetPercentile(0.99));
+    dict.put("duration_mean", duration_hist_.GetMean());
+    dict.put("duration_max", duration_hist_.GetMax());
+    dict.put("duration_p99", duration_hist_.GetPercentile(0.99));
+}
+
+
+void TickStatistics::Publish(yarp::os::BufferedPort<yarp::os::Bottle>& port, double interval) {
+
+    double now = yarp::os::Time::now();
+
+    if (now - published_ < interval || port.getOutputCount() == 0) {
+        return;
+    }
+
+    published_ = now;
+
+    yarp::os::Bottle& bottle = port.prepare();
+    bottle.clear();
+    Write(bottle);
+    port.write();
+}
+
+
+void TickStatistics::Print(std::ostream& os) const {
+
+    os << name_ << ": " << duration_hist_.GetCount() << " ticks, " << GetMisses() << " deadline misses, nominal period " << 1e3*period_ << " ms" << std::endl;
+
+    for (const auto& h : {std::make_pair("period", &period_hist_), std::make_pair("duration", &duration_hist_)}) {
+
+        os << "  " << h.first << " [ms]: mean " << 1e3*h.second->GetMean() << ", p99 < " << 1e3*h.second->GetPercentile(0.99)
+           << ", max " << 1e3*h.second->GetMax() << std::endl;
+
+        for (int i = 0; i < h.second->GetBins(); i++) {
+
+            if (h.second->GetHist(i) == 0) {
+                continue;
+            }
+
+            os << "    " << (i + 1 == h.second->GetBins() ? ">= " : "<  ") << 1e3*(i + 1 == h.second->GetBins() ? i : i + 1)*h.second->GetBin()
+               << ": " << h.second->GetHist(i) << std::endl;
+        }
+    }
+}
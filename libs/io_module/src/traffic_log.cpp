@@ -0,0 +1,296 @@
+#include "traffic_log.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Layout of the log. All numbers are stored in the byte order of the host.
+//
+//   header:  magic, version, number of channels, (length, name) per channel
+//   message: channel, time, count, stamp, size, data
+//   index:   number of messages, (offset, time, channel) per message
+//   trailer: offset of the index, magic
+//
+namespace {
+
+const char MAGIC[4] = {'H', 'T', 'L', 'G'};
+const uint32_t VERSION = 1;
+const std::streamoff TRAILER_SIZE = sizeof(uint64_t) + sizeof(MAGIC);
+const uint64_t MESSAGE_HEADER_SIZE = 2*sizeof(uint32_t) + sizeof(int32_t) + 2*sizeof(double);
+
+template<typename T>
+void Put(std::ostream& os, const T& value) {
+
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool Get(std::istream& is, T& value) {
+
+    return bool(is.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+} // namespace
+
+
+// Implement RawMessage.
+bool RawMessage::read(yarp::os::ConnectionReader& connection) {
+
+    data.resize(connection.getSize());
+
+    return data.empty() || connection.expectBlock(data.data(), data.size());
+}
+
+
+bool RawMessage::write(yarp::os::ConnectionWriter& connection) const {
+
+    connection.appendBlock(data.data(), data.size());
+
+    return true;
+}
+
+
+// Implement TrafficLogWriter.
+TrafficLogWriter::TrafficLogWriter(const std::string& path, const std::vector<std::string>& channels)
+  : file_(path.c_str(), std::ios::binary) {
+
+    if (!file_.is_open()) {
+        std::cerr << "Could not open " << path << " for writing." << std::endl;
+        std::exit(1);
+    }
+
+    file_.write(MAGIC, sizeof(MAGIC));
+    Put(file_, VERSION);
+    Put(file_, uint32_t(channels.size()));
+
+    for (const auto& channel : channels) {
+        Put(file_, uint32_t(channel.size()));
+        file_.write(channel.data(), channel.size());
+    }
+}
+
+
+TrafficLogWriter::~TrafficLogWriter() {
+
+    Close();
+}
+
+
+void TrafficLogWriter::Write(const TrafficMessage& msg) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!file_.is_open()) {
+        return;
+    }
+
+    index_.push_back({uint64_t(file_.tellp()), msg.time, msg.channel});
+
+    Put(file_, msg.channel);
+    Put(file_, msg.time);
+    Put(file_, msg.count);
+    Put(file_, msg.stamp);
+    Put(file_, uint32_t(msg.data.size()));
+    file_.write(msg.data.data(), msg.data.size());
+}
+
+
+void TrafficLogWriter::Close() {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!file_.is_open()) {
+        return;
+    }
+
+    uint64_t offset = file_.tellp();
+
+    Put(file_, uint64_t(index_.size()));
+
+    for (const auto& entry : index_) {
+        Put(file_, entry.offset);
+        Put(file_, entry.time);
+        Put(file_, entry.channel);
+    }
+
+    Put(file_, offset);
+    file_.write(MAGIC, sizeof(MAGIC));
+    file_.close();
+}
+
+
+// Implement TrafficLogReader.
+TrafficLogReader::TrafficLogReader(const std::string& path)
+  : file_(path.c_str(), std::ios::binary) {
+
+    char magic[sizeof(MAGIC)];
+    uint32_t version = 0;
+    uint32_t n = 0;
+
+    if (!file_.read(magic, sizeof(MAGIC)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !Get(file_, version) || version != VERSION || !Get(file_, n)) {
+        std::cerr << "Could not read traffic log " << path << "." << std::endl;
+        std::exit(1);
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+
+        uint32_t size = 0;
+        Get(file_, size);
+
+        std::string channel(size, ' ');
+        file_.read(&channel[0], size);
+        channels_.push_back(channel);
+    }
+
+    uint64_t begin = file_.tellg();
+
+    // Read the index, if the log was closed.
+    uint64_t offset = 0;
+    uint64_t size = 0;
+
+    file_.seekg(-TRAILER_SIZE, std::ios::end);
+
+    if (Get(file_, offset) && file_.read(magic, sizeof(MAGIC)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0) {
+
+        file_.seekg(offset);
+        Get(file_, size);
+        index_.resize(size);
+
+        for (auto& entry : index_) {
+            Get(file_, entry.offset);
+            Get(file_, entry.time);
+            Get(file_, entry.channel);
+        }
+    }
+
+    if (!file_ || index_.size() != size || size == 0) {
+
+        std::cout << "Traffic log " << path << " has no index, scanning messages." << std::endl;
+        file_.clear();
+        Scan(begin);
+    }
+}
+
+
+bool TrafficLogReader::Read(uint64_t i, TrafficMessage& msg) {
+
+    if (i >= index_.size()) {
+        return false;
+    }
+
+    uint32_t size = 0;
+
+    file_.clear();
+    file_.seekg(index_[i].offset);
+
+    bool ok = Get(file_, msg.channel) &&
+              Get(file_, msg.time) &&
+              Get(file_, msg.count) &&
+              Get(file_, msg.stamp) &&
+              Get(file_, size);
+
+    msg.data.resize(size);
+
+    return ok && file_.read(msg.data.data(), size);
+}
+
+
+uint64_t TrafficLogReader::Seek(double time) const {
+
+    return std::lower_bound(index_.begin(), index_.end(), time, [](const TrafficIndex& entry, double t) {
+        return entry.time < t;
+    }) - index_.begin();
+}
+
+
+void TrafficLogReader::Scan(uint64_t begin) {
+
+    index_.clear();
+
+    file_.clear();
+    file_.seekg(0, std::ios::end);
+    uint64_t end = file_.tellg();
+    file_.seekg(begin);
+
+    TrafficIndex entry;
+    int32_t count;
+    double stamp;
+    uint32_t size;
+
+    // Stop at the first message, which was not written completely.
+    while (Get(file_, entry.channel) &&
+           Get(file_, entry.time) &&
+           Get(file_, count) &&
+           Get(file_, stamp) &&
+           Get(file_, size)) {
+
+        uint64_t offset = file_.tellg();
+
+        if (entry.channel >= channels_.size() || offset + size > end) {
+            break;
+        }
+
+        entry.offset = offset - MESSAGE_HEADER_SIZE;
+        index_.push_back(entry);
+
+        file_.seekg(size, std::ios::cur);
+    }
+
+    file_.clear();
+}
+
+
+// Implement TrafficTap.
+TrafficTap::TrafficTap(TrafficLogWriter& log, uint32_t channel)
+  : log_(log),
+    count_(0) {
+
+    msg_.channel = channel;
+}
+
+
+bool TrafficTap::Open(const std::string& name, const std::string& source) {
+
+    port_.setReader(*this);
+
+    if (!port_.open(name)) {
+        return false;
+    }
+
+    return yarp::os::Network::connect(source, name, "tcp");
+}
+
+
+void TrafficTap::Close() {
+
+    port_.close();
+}
+
+
+bool TrafficTap::read(yarp::os::ConnectionReader& connection) {
+
+    msg_.time = yarp::os::Time::now();
+    msg_.data.resize(connection.getSize());
+
+    if (!msg_.data.empty() && !connection.expectBlock(msg_.data.data(), msg_.data.size())) {
+        return false;
+    }
+
+    // Envelope of the sender.
+    yarp::os::Stamp stamp;
+
+    if (port_.getEnvelope(stamp) && stamp.isValid()) {
+        msg_.count = stamp.getCount();
+        msg_.stamp = stamp.getTime();
+    }
+    else {
+        msg_.count = -1;
+        msg_.stamp = 0.;
+    }
+
+    log_.Write(msg_);
+    count_++;
+
+    return true;
+}
@@ -1,5 +1,7 @@
 #include "writer.h"
 
+#include <algorithm>
+
 WriteJoints::WriteJoints(int period, const std::string config_file_loc,
                          const std::string robot_name)
   : RateThread(period),
@@ -7,12 +9,40 @@ WriteJoints::WriteJoints(int period, const std::string config_file_loc,
     configs_(YAML::LoadFile(config_file_loc)),
     
     // Moving to the initial position.
-    robot_status_(NOT_INITIALIZED) {
+    robot_status_(NOT_INITIALIZED),
+    t_check_(0.),
+
+    // Tick statistics, at the streaming rate if segments are streamed.
+    stats_("write_joints", configs_["stream_period"].as<double>() > 0. ? configs_["stream_period"].as<double>() : period*1e-3,
+           configs_["stats_bin"].as<double>(), configs_["stats_bins"].as<int>(), configs_["stats_miss_tol"].as<double>()),
+
+    // Heartbeat.
+    heartbeat_("/write_joints/heartbeat", configs_["heartbeat_period"].as<double>()) {
 
     // Set configurations and drivers.
     SetConfigs();
     SetDrivers();
 
+    // Preallocate the in-process transport.
+    int joints = 0;
+
+    for (auto& part : parts_) {
+        joints += part.joints.size();
+    }
+
+    joint_command_ = JointCommand{0., Eigen::VectorXd::Zero(joints)};
+    commands_.reset(new Mailbox<JointCommand>(joint_command_));
+    segments_.reset(new Mailbox<JointSegment>());
+
+    q_stream_ = Eigen::VectorXd::Zero(joints);
+    dq_stream_ = Eigen::VectorXd::Zero(joints);
+    dq_end_ = Eigen::VectorXd::Zero(joints);
+
+    // Run at the streaming rate.
+    if (stream_period_ > 0.) {
+        setRate(stream_period_*1e3);
+    }
+
     // Open port to communicate initial position status.
     port_status_.open("/write_joints/robot_status");
 
@@ -22,6 +52,12 @@ WriteJoints::WriteJoints(int period, const std::string config_file_loc,
     if (port_.isClosed()) {
         std::cerr << "Could not open port " << port_name_ << std::endl;
     }
+
+    port_stats_.open("/write_joints/stats");
+
+    if (stream_period_ > 0.) {
+        port_segment_.open(segment_port_name_);
+    }
 }
 
 
@@ -33,23 +69,74 @@ WriteJoints::~WriteJoints() {
     // Close ports.
     port_status_.close();
     port_.close();
+    port_stats_.close();
+    port_segment_.close();
+}
+
+
+bool WriteJoints::threadInit() {
+
+    // Scheduling, affinity and memory of this thread.
+    SetRealtime(ReadRealtimeConfigs(configs_, "write_joints"), "write_joints");
+
+    return true;
 }
 
 
 void WriteJoints::run() {
 
+    stats_.Start();
+
     bool ok = true;
     int count = 0;
 
     // Run method implemented for RateThread, is called
     // every period ms. Here we want to write to the joints
     // of the robot defined in parts_.
-    // Read data from a port.
-    yarp::sig::Vector* q = port_.read(false);
+    // Read data from the in-process transport, or from a port.
+    bool received = false;
 
-    if (q != YARP_NULLPTR) {
-        
-        q_ = *q;
+    if (transport_ == "in_process" && commands_->PopLatest(joint_command_)) {
+
+        q_.resize(joint_command_.q.size());
+        yarp::eigen::toEigen(q_) = joint_command_.q;
+        received = true;
+    }
+    else {
+
+        yarp::sig::Vector* q = port_.read(false);
+
+        if (q != YARP_NULLPTR) {
+
+            q_ = *q;
+            received = true;
+        }
+    }
+
+    // Read a trajectory segment, to be streamed.
+    bool segment = false;
+
+    if (stream_period_ > 0.) {
+
+        if (transport_ == "in_process" && segments_->PopLatest(joint_segment_)) {
+
+            segment = true;
+        }
+        else {
+
+            yarp::sig::Matrix* knots = port_segment_.read(false);
+
+            if (knots != YARP_NULLPTR) {
+
+                // The first row holds the times of the knots.
+                joint_segment_.time = yarp::eigen::toEigen(*knots).row(0).transpose();
+                joint_segment_.q = yarp::eigen::toEigen(*knots).bottomRows(knots->rows() - 1);
+                segment = true;
+            }
+        }
+    }
+
+    if (received) {
 
         // Convert to degree.
         for (int i = 0; i < q_.size(); i++) {
@@ -58,7 +145,7 @@ void WriteJoints::run() {
         }
     }
 
-    if (robot_status_ == NOT_INITIALIZED && q != YARP_NULLPTR) {
+    if (robot_status_ == NOT_INITIALIZED && received) {
 
         // Set the control modes neccessary to reach the initial position.
         std::cout << "Moving to initial position." << std::endl;
@@ -82,9 +169,11 @@ void WriteJoints::run() {
         port_status_.write();
     }
 
-    else if (robot_status_ == INITIALIZING) {
+    else if (robot_status_ == INITIALIZING && yarp::os::Time::now() - t_check_ >= 0.1) {
 
-        // Check if the initial position was reached for every joint of every part.
+        // Check if the initial position was reached for every joint of every part,
+        // at most every 0.1 seconds, since each check is a request to the robot.
+        t_check_ = yarp::os::Time::now();
         bool done = true;
 
         for (auto& part : parts_) {
@@ -114,7 +203,31 @@ void WriteJoints::run() {
         }
     }
 
-    else if (q != YARP_NULLPTR && robot_status_ == INITIALIZED) {
+    else if (robot_status_ == INITIALIZED) {
+
+        double now = yarp::os::Time::now();
+
+        // A single command replaces the spline, a segment continues it.
+        if (received) {
+            spline_.Clear();
+        }
+
+        if (segment && joint_segment_.time.size() > 0) {
+            SetSpline(now);
+        }
+
+        if (!spline_.Empty()) {
+
+            // Sample the spline, in degree.
+            spline_.Evaluate(now, q_stream_, dq_stream_);
+
+            q_.resize(q_stream_.size());
+            yarp::eigen::toEigen(q_) = q_stream_*RAD2DEG;
+            received = true;
+        }
+    }
+
+    if (received && robot_status_ == INITIALIZED) {
 
         for (auto& part : parts_) {
 
@@ -131,6 +244,18 @@ void WriteJoints::run() {
         std::cout << "Could not move motors." << std::endl;
         std::exit(1);
     }
+
+    heartbeat_.Beat();
+
+    stats_.Stop();
+    stats_.Publish(port_stats_, stats_interval_);
+}
+
+
+void WriteJoints::threadRelease() {
+
+    // Dump the tick statistics.
+    stats_.Print();
 }
 
 
@@ -168,6 +293,16 @@ void WriteJoints::SetConfigs() {
 
     // Check for the joints port name to read from.
     port_name_ = configs_["joints_port_write"].as<std::string>();
+
+    // Check for the transport from the producer.
+    transport_ = configs_["transport"].as<std::string>();
+
+    // Check for streaming of trajectory segments.
+    stream_period_ = configs_["stream_period"].as<double>();
+    segment_port_name_ = configs_["joints_port_segment"].as<std::string>();
+
+    // Check for the interval of the tick statistics.
+    stats_interval_ = configs_["stats_interval"].as<double>();
 }
 
 
@@ -218,6 +353,58 @@ void WriteJoints::SetDrivers() {
 }
 
 
+void WriteJoints::SetSpline(double now) {
+
+    const Eigen::VectorXd& t = joint_segment_.time;
+    const Eigen::MatrixXd& q = joint_segment_.q;
+    const int n = t.size();
+
+    // Start at the current reference, so that position and velocity are continuous.
+    if (spline_.Empty()) {
+        q_stream_ = yarp::eigen::toEigen(q_)*DEG2RAD;
+        dq_stream_.setZero();
+    }
+    else {
+        spline_.Evaluate(now, q_stream_, dq_stream_);
+    }
+
+    // Knots, which lie in the future. Of a late segment, the last knot is
+    // reached one knot interval from now.
+    int first = 0;
+
+    while (first < n && t(first) <= now) {
+        first++;
+    }
+
+    int knots = std::max(n - first, 1);
+
+    knot_t_.resize(knots + 1);
+    knot_q_.resize(q.rows(), knots + 1);
+
+    knot_t_(0) = now;
+    knot_q_.col(0) = q_stream_;
+
+    if (first < n) {
+        knot_t_.tail(knots) = t.tail(knots);
+        knot_q_.rightCols(knots) = q.rightCols(knots);
+    }
+    else {
+        knot_t_(1) = now + (n > 1 ? t(n - 1) - t(n - 2) : stream_period_);
+        knot_q_.col(1) = q.col(n - 1);
+    }
+
+    // Leave the segment with its final slope.
+    if (n > 1 && first < n) {
+        dq_end_ = (q.col(n - 1) - q.col(n - 2))/(t(n - 1) - t(n - 2));
+    }
+    else {
+        dq_end_.setZero();
+    }
+
+    spline_.Fit(knot_t_, knot_q_, dq_stream_, dq_end_);
+}
+
+
 bool WriteJoints::SetControlModes(int mode) {
 
     // Set the control modes for every joint of every part.
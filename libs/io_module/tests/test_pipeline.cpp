@@ -0,0 +1,115 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "pipeline.h"
+
+
+struct Item {
+    double time;
+    int value;
+};
+
+
+// Test that a slow stage holds back the stages before it, instead of
+// losing the items, which they already processed.
+TEST(PipelineTest, Backpressure) {
+    Pipeline<Item> pipeline(2, Item{0., -1});
+
+    std::mutex mutex;
+    std::vector<int> values;
+
+    pipeline.AddStage("fast", [](Item& item) { item.value *= 2; return true; });
+    pipeline.AddStage("slow", [&](Item& item) {
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        std::lock_guard<std::mutex> lock(mutex);
+        values.push_back(item.value);
+        return true;
+    });
+
+    pipeline.Start();
+
+    const int n = 20;
+
+    for (int i = 0; i < n; i++) {
+
+        // The producer retries, when the first queue is full.
+        while (!pipeline.Push(Item{yarp::os::Time::now(), i})) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    for (int k = 0; k < 1000; k++) {
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (values.size() == n) {
+                break;
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    pipeline.Stop();
+
+    ASSERT_EQ(values.size(), n);
+
+    for (int i = 0; i < n; i++) {
+        EXPECT_EQ(values[i], 2*i);
+    }
+
+    EXPECT_EQ(pipeline.GetProcessed(pipeline.GetStage("fast")), n);
+    EXPECT_EQ(pipeline.GetDropped(pipeline.GetStage("slow")), 0);
+}
+
+
+// Test that a latest stage takes every pushed item, replacing the waiting
+// one, so that the most recent item is processed last.
+TEST(PipelineTest, Latest) {
+    Pipeline<Item> pipeline(2, Item{0., -1});
+
+    std::mutex mutex;
+    std::vector<int> values;
+
+    pipeline.AddStage("latest", [&](Item& item) {
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        std::lock_guard<std::mutex> lock(mutex);
+        values.push_back(item.value);
+        return true;
+    }, 0., true);
+
+    pipeline.Start();
+
+    const int n = 10;
+
+    for (int i = 0; i < n; i++) {
+        EXPECT_TRUE(pipeline.Push(Item{yarp::os::Time::now(), i}));
+    }
+
+    for (int k = 0; k < 1000; k++) {
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (!values.empty() && values.back() == n - 1) {
+                break;
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    pipeline.Stop();
+
+    ASSERT_FALSE(values.empty());
+    EXPECT_EQ(values.back(), n - 1);
+    EXPECT_TRUE(std::is_sorted(values.begin(), values.end()));
+    EXPECT_EQ(pipeline.GetProcessed(0) + pipeline.GetDropped(0), n);
+}
@@ -0,0 +1,139 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "ring_buffer.h"
+#include "mailbox.h"
+
+
+// Test that a full buffer rejects new elements and keeps the queued ones.
+TEST(RingBufferTest, Full) {
+    RingBuffer<int> buffer(3);
+
+    EXPECT_TRUE(buffer.Empty());
+
+    for (int i = 0; i < 3; i++) {
+        EXPECT_TRUE(buffer.Push(i));
+    }
+
+    EXPECT_FALSE(buffer.Push(3));
+
+    int element = -1;
+
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(buffer.Pop(element));
+        EXPECT_EQ(element, i);
+    }
+
+    EXPECT_FALSE(buffer.Pop(element));
+    EXPECT_TRUE(buffer.Empty());
+}
+
+
+// Test that the order is kept, while the indices wrap around.
+TEST(RingBufferTest, WrapAround) {
+    RingBuffer<int> buffer(3);
+
+    int element = -1;
+    int expected = 0;
+
+    for (int i = 0; i < 20; i++) {
+        ASSERT_TRUE(buffer.Push(2*i));
+        ASSERT_TRUE(buffer.Push(2*i + 1));
+
+        ASSERT_TRUE(buffer.Pop(element));
+        EXPECT_EQ(element, expected++);
+        ASSERT_TRUE(buffer.Pop(element));
+        EXPECT_EQ(element, expected++);
+    }
+
+    EXPECT_TRUE(buffer.Empty());
+}
+
+
+// Test that the latest element is taken, across the wrap around.
+TEST(RingBufferTest, PopLatest) {
+    RingBuffer<int> buffer(3);
+
+    int element = -1;
+
+    EXPECT_FALSE(buffer.PopLatest(element));
+
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(buffer.Push(3*i));
+        ASSERT_TRUE(buffer.Push(3*i + 1));
+
+        ASSERT_TRUE(buffer.PopLatest(element));
+        EXPECT_EQ(element, 3*i + 1);
+        EXPECT_TRUE(buffer.Empty());
+    }
+
+    // Elements, which found the buffer full, are not taken.
+    for (int i = 0; i < 5; i++) {
+        buffer.Push(i);
+    }
+
+    ASSERT_TRUE(buffer.PopLatest(element));
+    EXPECT_EQ(element, 2);
+}
+
+
+// Test that the mailbox always hands over the latest element.
+TEST(MailboxTest, PopLatest) {
+    Mailbox<int> mailbox(-1);
+
+    int element = 0;
+
+    EXPECT_TRUE(mailbox.Empty());
+    EXPECT_FALSE(mailbox.PopLatest(element));
+
+    // Pushing never fails, and overwrites the elements, which were not taken.
+    EXPECT_TRUE(mailbox.Push(0));
+
+    for (int i = 1; i < 10; i++) {
+        EXPECT_FALSE(mailbox.Push(i));
+    }
+
+    ASSERT_TRUE(mailbox.PopLatest(element));
+    EXPECT_EQ(element, 9);
+    EXPECT_FALSE(mailbox.PopLatest(element));
+
+    for (int i = 10; i < 20; i++) {
+        EXPECT_TRUE(mailbox.Push(i));
+        ASSERT_TRUE(mailbox.PopLatest(element));
+        EXPECT_EQ(element, i);
+    }
+
+    EXPECT_TRUE(mailbox.Empty());
+}
+
+
+// Test that the consumer only sees complete and increasingly recent elements,
+// while the producer keeps pushing.
+TEST(MailboxTest, Concurrent) {
+    const int n = 100000;
+    Mailbox<std::vector<int>> mailbox(std::vector<int>(16, -1));
+
+    std::thread producer([&mailbox, n]() {
+        std::vector<int> element(16);
+
+        for (int i = 0; i < n; i++) {
+            std::fill(element.begin(), element.end(), i);
+            mailbox.Push(element);
+        }
+    });
+
+    std::vector<int> element(16, -1);
+    int last = -1;
+
+    while (last < n - 1) {
+        if (mailbox.PopLatest(element)) {
+            ASSERT_GT(element[0], last);
+            ASSERT_EQ(std::count(element.begin(), element.end(), element[0]), 16);
+            last = element[0];
+        }
+    }
+
+    producer.join();
+}
@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+#include "shared_image_ring.h"
+
+// The fixture for testing the class SharedImageRing.
+class SharedImageRingTest : public ::testing::Test {
+    protected:
+
+    // Constructor.
+    SharedImageRingTest()
+      : name_("/shared_image_ring_test_" + std::to_string(getpid())),
+        producer_(name_),
+        consumer_(name_) {
+        producer_.Create(4, 16);
+    }
+
+    // Write a frame of 2x2 pixels with 3 channels, filled with value.
+    void Write(unsigned char value, double time) {
+        unsigned char* data = producer_.BeginWrite(2, 2, 3);
+        ASSERT_NE(data, nullptr);
+        std::memset(data, value, 12);
+        producer_.EndWrite(time);
+    }
+
+    // Member variables.
+    std::string name_;
+    SharedImageRing producer_;
+    SharedImageRing consumer_;
+};
+
+
+// Test that every frame is read once, by its written count, across all slots.
+TEST_F(SharedImageRingTest, ReadLatest) {
+    SharedFrame frame;
+
+    ASSERT_TRUE(consumer_.Open());
+    EXPECT_FALSE(consumer_.ReadLatest(frame));
+
+    uint64_t last = 0;
+
+    for (int i = 0; i < 10; i++) {
+        Write(i, 0.1*i);
+
+        ASSERT_TRUE(consumer_.ReadLatest(frame));
+        EXPECT_EQ(frame.written, uint64_t(i + 1));
+        EXPECT_NE(frame.written, last);
+        EXPECT_EQ(frame.slot, i % 4);
+        EXPECT_EQ(frame.data[0], i);
+        EXPECT_EQ(frame.width, 2);
+        EXPECT_EQ(frame.height, 2);
+        EXPECT_EQ(frame.channels, 3);
+        EXPECT_DOUBLE_EQ(frame.time, 0.1*i);
+        EXPECT_TRUE(consumer_.Valid(frame));
+
+        last = frame.written;
+    }
+}
+
+
+// Test that the frame closest in time is found among the slots.
+TEST_F(SharedImageRingTest, ReadClosest) {
+    ASSERT_TRUE(consumer_.Open());
+
+    for (int i = 0; i < 6; i++) {
+        Write(i, double(i));
+    }
+
+    // Only the last 4 frames are still in the ring.
+    SharedFrame frame;
+
+    ASSERT_TRUE(consumer_.ReadClosest(3.2, frame));
+    EXPECT_EQ(frame.data[0], 3);
+    EXPECT_EQ(frame.written, uint64_t(4));
+
+    ASSERT_TRUE(consumer_.ReadClosest(0., frame));
+    EXPECT_EQ(frame.data[0], 2);
+}
+
+
+// Test that frames become invalid, once their slot is written again.
+TEST_F(SharedImageRingTest, Valid) {
+    ASSERT_TRUE(consumer_.Open());
+
+    Write(1, 0.);
+
+    SharedFrame frame;
+    ASSERT_TRUE(consumer_.ReadLatest(frame));
+
+    for (int i = 0; i < 3; i++) {
+        Write(2, 1.);
+        EXPECT_TRUE(consumer_.Valid(frame));
+    }
+
+    // Being written.
+    ASSERT_NE(producer_.BeginWrite(2, 2, 3), nullptr);
+    EXPECT_FALSE(consumer_.Valid(frame));
+    producer_.EndWrite(2.);
+    EXPECT_FALSE(consumer_.Valid(frame));
+
+    // Images, which exceed a slot, are rejected.
+    EXPECT_EQ(producer_.BeginWrite(4, 4, 3), nullptr);
+}
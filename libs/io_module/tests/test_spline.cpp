@@ -0,0 +1,146 @@
+#include "gtest/gtest.h"
+#include <cmath>
+#include <Eigen/Core>
+
+#include "spline.h"
+
+
+// Knots of two signals, at uneven times.
+static void Knots(Eigen::VectorXd& t, Eigen::MatrixXd& y) {
+
+    t.resize(5);
+    t << 0., 0.1, 0.25, 0.3, 0.5;
+
+    y.resize(2, 5);
+    y << 0., 1., -0.5, 0.2,  0.3,
+         2., 2.,  1.,  1.5, -1.;
+}
+
+
+// Test that the spline passes through the knots.
+TEST(CubicSplineTest, Interpolation) {
+    Eigen::VectorXd t;
+    Eigen::MatrixXd y;
+    Knots(t, y);
+
+    CubicSpline spline;
+    spline.Fit(t, y, Eigen::Vector2d(0.5, -1.), Eigen::Vector2d(0., 2.));
+
+    EXPECT_FALSE(spline.Empty());
+    EXPECT_DOUBLE_EQ(spline.Begin(), 0.);
+    EXPECT_DOUBLE_EQ(spline.End(), 0.5);
+
+    Eigen::VectorXd q(2), dq(2);
+
+    for (int i = 0; i < t.size(); i++) {
+        spline.Evaluate(t(i), q, dq);
+        EXPECT_TRUE(q.isApprox(y.col(i), 1e-12)) << "knot " << i;
+    }
+
+    // Outside of the knots, the spline holds the value.
+    spline.Evaluate(-1., q, dq);
+    EXPECT_TRUE(q.isApprox(y.col(0)));
+    EXPECT_TRUE(dq.isZero());
+
+    spline.Evaluate(1., q, dq);
+    EXPECT_TRUE(q.isApprox(y.col(4)));
+    EXPECT_TRUE(dq.isZero());
+}
+
+
+// Test that the spline starts and ends with the prescribed slopes.
+TEST(CubicSplineTest, EndSlopes) {
+    Eigen::VectorXd t;
+    Eigen::MatrixXd y;
+    Knots(t, y);
+
+    const Eigen::Vector2d v0(0.5, -1.);
+    const Eigen::Vector2d v1(0., 2.);
+
+    CubicSpline spline;
+    spline.Fit(t, y, v0, v1);
+
+    Eigen::VectorXd q(2), dq(2);
+
+    spline.Evaluate(1e-9, q, dq);
+    EXPECT_NEAR((dq - v0).norm(), 0., 1e-6);
+
+    spline.Evaluate(0.5 - 1e-9, q, dq);
+    EXPECT_NEAR((dq - v1).norm(), 0., 1e-6);
+}
+
+
+// Test that the slope is continuous at the inner knots.
+TEST(CubicSplineTest, ContinuousSlope) {
+    Eigen::VectorXd t;
+    Eigen::MatrixXd y;
+    Knots(t, y);
+
+    CubicSpline spline;
+    spline.Fit(t, y, Eigen::Vector2d(0.5, -1.), Eigen::Vector2d(0., 2.));
+
+    Eigen::VectorXd q(2), dq_before(2), dq_after(2);
+
+    for (int i = 1; i < t.size() - 1; i++) {
+        spline.Evaluate(t(i) - 1e-9, q, dq_before);
+        spline.Evaluate(t(i) + 1e-9, q, dq_after);
+        EXPECT_NEAR((dq_before - dq_after).norm(), 0., 1e-5) << "knot " << i;
+    }
+}
+
+
+// Test that a spline, which is fit from the state of another one, as the
+// writer does for each new segment, continues it with the same value and slope.
+TEST(CubicSplineTest, ContinuousAcrossSegments) {
+    Eigen::VectorXd t;
+    Eigen::MatrixXd y;
+    Knots(t, y);
+
+    CubicSpline first;
+    first.Fit(t, y, Eigen::Vector2d(0.5, -1.), Eigen::Vector2d(0., 2.));
+
+    // The next segment arrives in the middle of the first one.
+    const double now = 0.2;
+
+    Eigen::VectorXd q(2), dq(2);
+    first.Evaluate(now, q, dq);
+
+    Eigen::VectorXd t_next(3);
+    t_next << now, 0.4, 0.6;
+
+    Eigen::MatrixXd y_next(2, 3);
+    y_next.col(0) = q;
+    y_next.col(1) << 1., 0.;
+    y_next.col(2) << 0., 1.;
+
+    CubicSpline second;
+    second.Fit(t_next, y_next, dq, Eigen::Vector2d::Zero());
+
+    Eigen::VectorXd q_next(2), dq_next(2);
+    second.Evaluate(now + 1e-9, q_next, dq_next);
+
+    EXPECT_NEAR((q_next - q).norm(), 0., 1e-6);
+    EXPECT_NEAR((dq_next - dq).norm(), 0., 1e-5);
+}
+
+
+// Test that a spline without knots holds and does not read them.
+TEST(CubicSplineTest, Empty) {
+    CubicSpline spline;
+    EXPECT_TRUE(spline.Empty());
+
+    Eigen::VectorXd t(1);
+    t << 1.;
+    Eigen::MatrixXd y(2, 1);
+    y << 3., 4.;
+
+    spline.Fit(t, y, Eigen::Vector2d::Zero(), Eigen::Vector2d::Zero());
+    EXPECT_TRUE(spline.Empty());
+
+    Eigen::VectorXd q(2), dq(2);
+    dq.setOnes();
+
+    spline.Evaluate(2., q, dq);
+    EXPECT_TRUE(q.isApprox(y.col(0)));
+    EXPECT_TRUE(dq.isZero());
+}
@@ -0,0 +1,117 @@
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+#include "traffic_log.h"
+
+// The fixture for testing the classes TrafficLogWriter and TrafficLogReader.
+class TrafficLogTest : public ::testing::Test {
+    protected:
+
+    // Constructor.
+    TrafficLogTest()
+      : path_("traffic_log_test_" + std::to_string(getpid()) + ".log"),
+        channels_({"/joints/read", "/reader/vel"}) { }
+
+    // Destructor.
+    virtual ~TrafficLogTest() {
+        std::remove(path_.c_str());
+    }
+
+    // Message i, alternating between the channels, with data of i + 1 bytes.
+    TrafficMessage Message(int i) {
+        TrafficMessage msg;
+        msg.channel = i % 2;
+        msg.time = 0.01*i;
+        msg.count = i % 3 == 0 ? -1 : i;
+        msg.stamp = 0.01*i - 0.001;
+        msg.data.assign(i + 1, char('a' + i));
+        return msg;
+    }
+
+    // Write n messages, and close the log.
+    void WriteLog(int n) {
+        TrafficLogWriter writer(path_, channels_);
+
+        for (int i = 0; i < n; i++) {
+            writer.Write(Message(i));
+        }
+
+        EXPECT_EQ(writer.GetSize(), uint64_t(n));
+        writer.Close();
+    }
+
+    // Check that message i was read unchanged.
+    void ExpectMessage(const TrafficMessage& msg, int i) {
+        TrafficMessage expected = Message(i);
+        EXPECT_EQ(msg.channel, expected.channel);
+        EXPECT_DOUBLE_EQ(msg.time, expected.time);
+        EXPECT_EQ(msg.count, expected.count);
+        EXPECT_DOUBLE_EQ(msg.stamp, expected.stamp);
+        EXPECT_EQ(msg.data, expected.data);
+    }
+
+    // Member variables.
+    std::string path_;
+    std::vector<std::string> channels_;
+};
+
+
+// Test that messages are read as they were written, from the index.
+TEST_F(TrafficLogTest, RoundTrip) {
+    WriteLog(20);
+
+    TrafficLogReader reader(path_);
+
+    EXPECT_EQ(reader.GetChannels(), channels_);
+    ASSERT_EQ(reader.GetSize(), uint64_t(20));
+
+    TrafficMessage msg;
+
+    // In any order.
+    for (int i = 19; i >= 0; i--) {
+        ASSERT_TRUE(reader.Read(i, msg));
+        ExpectMessage(msg, i);
+    }
+
+    EXPECT_FALSE(reader.Read(20, msg));
+
+    // First message at or after a time.
+    EXPECT_EQ(reader.Seek(-1.), uint64_t(0));
+    EXPECT_EQ(reader.Seek(0.055), uint64_t(6));
+    EXPECT_EQ(reader.Seek(1.), uint64_t(20));
+}
+
+
+// Test that a log, which was not closed, is indexed by scanning its complete messages.
+TEST_F(TrafficLogTest, Recovery) {
+    WriteLog(10);
+
+    // Cut off the index, and half of the last message.
+    std::ifstream in(path_, std::ios::binary);
+    std::string log((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    TrafficLogReader closed(path_);
+    ASSERT_EQ(closed.GetSize(), uint64_t(10));
+
+    // Channel, time, count, stamp and size of the last message, and 5 of its 10 bytes.
+    const uint64_t end = closed.GetIndex()[9].offset + 3*sizeof(uint32_t) + 2*sizeof(double) + 5;
+
+    std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+    out.write(log.data(), end);
+    out.close();
+
+    TrafficLogReader reader(path_);
+    TrafficMessage msg;
+
+    EXPECT_EQ(reader.GetChannels(), channels_);
+    ASSERT_EQ(reader.GetSize(), uint64_t(9));
+
+    for (int i = 0; i < 9; i++) {
+        ASSERT_TRUE(reader.Read(i, msg));
+        ExpectMessage(msg, i);
+    }
+}
@@ -1,13 +1,19 @@
 #ifndef KINEMATICS_KINEMATICS_H_
 #define KINEMATICS_KINEMATICS_H_
 
+#include <chrono>
 #include <iostream>
+#include <map>
+#include <thread>
 #include <rbdl/rbdl.h>
 #include <rbdl/addons/urdfreader/urdfreader.h>
 #include <vector>
 #include <Eigen/Dense>
 #include <yaml-cpp/yaml.h>
 
+#include "model_cache.h"
+#include "statistics.h"
+
 class Kinematics
 {
     public:
@@ -26,6 +32,13 @@ class Kinematics
                      Eigen::MatrixXd& lf_traj,
                      Eigen::MatrixXd& rf_traj);
 
+        // Perform inverse kinematics on a whole pattern offline. The pattern is
+        // split into segments, which are solved in parallel on copies of this
+        // instance, and stitched together afterwards.
+        void InverseBatch(Eigen::MatrixXd& com_traj,
+                          Eigen::MatrixXd& lf_traj,
+                          Eigen::MatrixXd& rf_traj);
+
         // Get joint angles, center of mass and other things.
         inline const bool&                              GetStatus() const { return ik_status_; };
         inline const RigidBodyDynamics::Math::Vector3d& GetComPos() const { return com_pos_;   };
@@ -34,10 +47,35 @@ class Kinematics
         inline const RigidBodyDynamics::Math::Vector3d& GetLFPos()  const { return lf_pos_;    };
         inline const RigidBodyDynamics::Math::Vector3d& GetRFPos()  const { return rf_pos_;    };
         inline const Eigen::MatrixXd&                   GetQTraj()  const { return q_traj_;    };
+        inline const IKStatistics&                      GetStatistics() const { return stats_; };
 
         // Setters.
         void SetQInit(Eigen::VectorXd& q);
 
+    private:
+
+        // Statistics of the last inverse kinematics call, without time and warm start.
+        IKSample Sample() const;
+
+        // Norm of the residual of a constraint after the last iteration.
+        double Residual(uint id) const;
+
+        // Update the center of mass body point from a position only update
+        // of the kinematics at q.
+        void UpdateComBodyPoint(Eigen::VectorXd& q);
+
+        // Quantized pose of the feet relative to the center of mass, used to index the seed cache.
+        std::vector<int> SeedKey(const Eigen::Vector4d& com, const Eigen::Vector4d& lf, const Eigen::Vector4d& rf) const;
+
+        // Frame of the center of mass, rotated by its yaw, in which the seeds keep the floating base.
+        Eigen::Matrix3d SeedFrame(const Eigen::Vector4d& com) const;
+
+        // Replace q_init_ by a cached seed, if there is one.
+        bool ApplySeed(const std::vector<int>& key, const Eigen::Vector4d& com);
+
+        // Store a converged solution in the seed cache.
+        void StoreSeed(const std::vector<int>& key, const Eigen::Vector4d& com);
+
     public:
 
         // Configurations.
@@ -50,8 +88,27 @@ class Kinematics
         // Inverse kinematics status.
         bool ik_status_;
 
+        // Batch inverse kinematics.
+        uint batch_threads_;
+        uint batch_coarse_stride_;
+        double batch_stitch_tol_;
+
+        // Seed cache, which maps the quantized pose of the feet relative to the
+        // center of mass onto converged joint angles. The floating base translation
+        // is stored relative to the center of mass target.
+        bool seed_cache_;
+        double seed_cache_res_;
+        uint seed_cache_size_;
+        double seed_jump_tol_;
+
+        std::map<std::vector<int>, Eigen::VectorXd> seeds_;
+
+        // Previous targets of the pattern, to detect discontinuities.
+        Eigen::VectorXd seed_prev_;
+        bool seed_prev_valid_;
+
         // Model and constraint set.
-        RigidBodyDynamics::Model* model_;
+        RigidBodyDynamics::Model model_;
         RigidBodyDynamics::InverseKinematicsConstraintSet cs_;
 
         // Body points.
@@ -75,6 +132,17 @@ class Kinematics
         uint lf_id_;
         uint rf_id_;
 
+        uint chest_body_id_;
+        uint root_body_id_;
+        uint lf_body_id_;
+        uint rf_body_id_;
+
+        // Whether the center of mass body point belongs to q_init_.
+        bool com_bp_valid_;
+
+        // Statistics of every solved column.
+        IKStatistics stats_;
+
         // Generalized coordinates of model.
         Eigen::VectorXd q_init_;
         Eigen::VectorXd q_res_;
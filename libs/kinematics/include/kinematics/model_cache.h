@@ -0,0 +1,30 @@
+#ifndef KINEMATICS_MODEL_CACHE_H_
+#define KINEMATICS_MODEL_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <rbdl/rbdl.h>
+
+// Body id's that are looked up by name.
+struct BodyIds {
+    uint32_t chest;
+    uint32_t root;
+    uint32_t lf;
+    uint32_t rf;
+};
+
+// Hash of the content of a file, used to key the cache.
+uint64_t HashFile(const std::string& file_loc);
+
+// Binary cache of a model that was built from an urdf file. The cache
+// stores the bodies and joints in the order they were added to the model,
+// so that the model can be rebuilt without parsing the urdf file.
+//
+// Reading returns false if the cache does not exist, belongs to a different
+// hash, or is corrupted. Writing returns false if the model contains joints
+// that can not be stored.
+bool ReadModelCache(const std::string& cache_loc, uint64_t hash, RigidBodyDynamics::Model& model, BodyIds& ids);
+
+bool WriteModelCache(const std::string& cache_loc, uint64_t hash, const RigidBodyDynamics::Model& model, const BodyIds& ids);
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef KINEMATICS_STATISTICS_H_
+#define KINEMATICS_STATISTICS_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Statistics of the inverse kinematics for a single column of the pattern.
+struct IKSample {
+
+    // Iterations used by the solver.
+    uint iterations;
+
+    // Final residual of every constraint.
+    double com_residual;
+    double root_residual;
+    double lf_residual;
+    double rf_residual;
+
+    // Wall time in seconds.
+    double time;
+
+    // Distance between the warm start and the solution.
+    double warm_start_dist;
+
+    bool converged;
+};
+
+
+// IKStatistics keeps the most recent samples in a ring
+// buffer, and aggregates all samples in histograms of the
+// iterations and the wall time.
+class IKStatistics
+{
+    public:
+
+        IKStatistics(uint size = 1000, uint iteration_bin = 5, double time_bin = 1e-4, uint bins = 20);
+
+        // Add a sample.
+        void Add(const IKSample& sample);
+
+        // Add the samples and histograms of another instance.
+        void Merge(const IKStatistics& other);
+
+        void Reset();
+
+        // Most recent samples, oldest first.
+        std::vector<IKSample> GetSamples() const;
+
+        // Getters.
+        inline const std::vector<uint>& GetIterationHistogram() const { return iteration_hist_; };
+        inline const std::vector<uint>& GetTimeHistogram()      const { return time_hist_;      };
+        inline uint                     GetCount()              const { return count_;          };
+        inline uint                     GetFailures()           const { return failures_;       };
+
+        // Print a summary of all samples.
+        void Print(std::ostream& os = std::cout) const;
+
+        // Write the most recent samples to a .csv file.
+        void WriteCsv(const std::string& path) const;
+
+    private:
+
+        // Ring buffer of recent samples.
+        std::vector<IKSample> samples_;
+        uint head_;
+        uint size_;
+
+        // Histograms, the last bin collects everything above.
+        uint iteration_bin_;
+        double time_bin_;
+
+        std::vector<uint> iteration_hist_;
+        std::vector<uint> time_hist_;
+
+        // Aggregates over all samples.
+        uint count_;
+        uint failures_;
+        double iterations_sum_;
+        uint iterations_max_;
+        double time_sum_;
+        double time_max_;
+};
+
+#endif
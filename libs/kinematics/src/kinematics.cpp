@@ -10,11 +10,50 @@ Kinematics::Kinematics(const std::string config_file_loc)
     n_init_(configs_["n_init"].as<uint>()),
     
     // Inverse kinematics status.
-    ik_status_(true) {
+    ik_status_(true),
+
+    // Batch inverse kinematics.
+    batch_threads_(configs_["batch_threads"].as<uint>()),
+    batch_coarse_stride_(configs_["batch_coarse_stride"].as<uint>()),
+    batch_stitch_tol_(configs_["batch_stitch_tol"].as<double>()),
+
+    // Seed cache.
+    seed_cache_(configs_["seed_cache"].as<bool>()),
+    seed_cache_res_(configs_["seed_cache_resolution"].as<double>()),
+    seed_cache_size_(configs_["seed_cache_size"].as<uint>()),
+    seed_jump_tol_(configs_["seed_jump_tol"].as<double>()),
+    seed_prev_(9),
+    seed_prev_valid_(false),
+    
+    // Center of mass body point.
+    com_bp_valid_(false),
+
+    // Statistics.
+    stats_(configs_["stats_size"].as<uint>(),
+           configs_["stats_iteration_bin"].as<uint>(),
+           configs_["stats_time_bin"].as<double>(),
+           configs_["stats_bins"].as<uint>()) {
+
+        // Load kinematic model from the cache, or from urdf file if the cache
+        // is missing or belongs to a different urdf file.
+        const std::string urdf_loc = configs_["urdf_loc"].as<std::string>();
+        const std::string cache_loc = urdf_loc + ".cache";
+        const bool model_cache = configs_["model_cache"].as<bool>();
+        const uint64_t hash = model_cache ? HashFile(urdf_loc) : 0;
+
+        BodyIds ids;
+
+        if (!model_cache || !ReadModelCache(cache_loc, hash, model_, ids)) {
 
-        // Load kinematic model from urdf file.
-        model_ = new RigidBodyDynamics::Model();
-        RigidBodyDynamics::Addons::URDFReadFromFile(configs_["urdf_loc"].as<std::string>().c_str(), model_, true, false);
+            RigidBodyDynamics::Addons::URDFReadFromFile(urdf_loc.c_str(), &model_, true, false);
+
+            ids = BodyIds{model_.GetBodyId("chest"), model_.GetBodyId("root_link"),
+                          model_.GetBodyId("l_sole"), model_.GetBodyId("r_sole")};
+
+            if (model_cache && !WriteModelCache(cache_loc, hash, model_, ids)) {
+                std::cerr << "Could not write model cache " << cache_loc << std::endl;
+            }
+        }
 
         // Set optimization parameters.
         cs_.step_tol = configs_["step_tol"].as<double>();
@@ -22,18 +61,24 @@ Kinematics::Kinematics(const std::string config_file_loc)
         cs_.num_steps = configs_["num_steps"].as<uint>();
 
         // Initialize the joint angles.
-        q_init_ = Eigen::VectorXd::Zero(model_->dof_count);
-        q_res_ = Eigen::VectorXd::Zero(model_->dof_count);
-        q_traj_ = Eigen::MatrixXd::Zero(model_->dof_count, 1);
+        q_init_ = Eigen::VectorXd::Zero(model_.dof_count);
+        q_res_ = Eigen::VectorXd::Zero(model_.dof_count);
+        q_traj_ = Eigen::MatrixXd::Zero(model_.dof_count, 1);
+
+        dq_init_ = Eigen::VectorXd::Zero(model_.dof_count);
 
-        dq_init_ = Eigen::VectorXd::Zero(model_->dof_count);
+        // Body id's.
+        chest_body_id_ = ids.chest;
+        root_body_id_ = ids.root;
+        lf_body_id_ = ids.lf;
+        rf_body_id_ = ids.rf;
 }
 
 
 Kinematics::~Kinematics() {
     
-    // Delete model.
-    delete model_;
+    // The model is owned by value, so that copies of Kinematics, e.g. one
+    // per thread in InverseBatch(), do not share it.
 }
 
 
@@ -41,6 +86,12 @@ void Kinematics::SetQInit(Eigen::VectorXd& q) {
 
     // Set q_init_ for feedback.
     q_init_ = q;
+
+    // The center of mass body point needs to be recomputed for the new q_init_.
+    com_bp_valid_ = false;
+
+    // The new q_init_ may not belong to the previous targets.
+    seed_prev_valid_ = false;
 }
 
 
@@ -49,10 +100,10 @@ void Kinematics::Forward(Eigen::VectorXd&   q,
                          Eigen::VectorXd& ddq) {
     
     // Calculate forward kinematics.
-    RigidBodyDynamics::Utils::CalcCenterOfMass(*model_, q, dq, NULL, mass_, com_pos_);//, &com_vel_, &com_acc_);  
+    RigidBodyDynamics::Utils::CalcCenterOfMass(model_, q, dq, NULL, mass_, com_pos_);//, &com_vel_, &com_acc_);  
 
-    lf_pos_ = rf_ori_init_.transpose()*RigidBodyDynamics::CalcBodyToBaseCoordinates(*model_, q, lf_id_, lf_bp_);
-    rf_pos_ = rf_ori_init_.transpose()*RigidBodyDynamics::CalcBodyToBaseCoordinates(*model_, q, rf_id_, rf_bp_);
+    lf_pos_ = rf_ori_init_.transpose()*RigidBodyDynamics::CalcBodyToBaseCoordinates(model_, q, lf_id_, lf_bp_);
+    rf_pos_ = rf_ori_init_.transpose()*RigidBodyDynamics::CalcBodyToBaseCoordinates(model_, q, rf_id_, rf_bp_);
 
     // Correct for rotated model.
     com_pos_ = rf_ori_init_.transpose()*com_pos_;
@@ -66,9 +117,9 @@ void Kinematics::Inverse(Eigen::MatrixXd& com_traj,
                          Eigen::MatrixXd& rf_traj) {
 
     // Resize q_traj if needed.
-    if (q_traj_.rows() !=  model_->dof_count || q_traj_.cols() != com_traj.cols()) {
+    if (q_traj_.rows() !=  model_.dof_count || q_traj_.cols() != com_traj.cols()) {
 
-        q_traj_.resize(model_->dof_count, com_traj.cols());
+        q_traj_.resize(model_.dof_count, com_traj.cols());
     }
 
     // Check if inverse kinematics has gotten initialized.
@@ -76,13 +127,40 @@ void Kinematics::Inverse(Eigen::MatrixXd& com_traj,
 
         for (int i = 0; i < com_traj.cols(); i++) {
 
-            // Use the real com as body point.
-            RigidBodyDynamics::Utils::CalcCenterOfMass(*model_, q_init_, dq_init_, NULL, mass_, com_pos_);
+            // Target of the center of mass.
+            Eigen::Vector3d com_target = rf_ori_init_*com_traj.block(0, i, 3, 1);
+
+            // Start from the seed cache on discontinuities of the pattern.
+            std::vector<int> key;
+            bool seeded = false;
+
+            if (seed_cache_) {
+
+                key = SeedKey(com_traj.col(i), lf_traj.col(i), rf_traj.col(i));
+
+                Eigen::VectorXd cur(9);
+                cur << com_traj.block(0, i, 3, 1), lf_traj.block(0, i, 3, 1), rf_traj.block(0, i, 3, 1);
+
+                if (seed_prev_valid_ && (cur - seed_prev_).cwiseAbs().maxCoeff() > seed_jump_tol_) {
+                    seeded = ApplySeed(key, com_traj.col(i));
+                }
+
+                seed_prev_ = cur;
+                seed_prev_valid_ = true;
+            }
+
+            // Use the real com as body point. It is usually already known from
+            // the previous column, and only needs a full pass through the tree
+            // if q_init_ was set from outside.
+            if (!com_bp_valid_) {
 
-            cs_.body_points[com_id_] = RigidBodyDynamics::CalcBaseToBodyCoordinates(*model_, q_init_, model_->GetBodyId("chest"), com_pos_);
+                RigidBodyDynamics::Utils::CalcCenterOfMass(model_, q_init_, dq_init_, NULL, mass_, com_pos_);
+
+                cs_.body_points[com_id_] = RigidBodyDynamics::CalcBaseToBodyCoordinates(model_, q_init_, chest_body_id_, com_pos_);
+            }
 
             // Set position constraints.
-            cs_.target_positions[com_id_] = rf_ori_init_*com_traj.block(0, i, 3, 1);
+            cs_.target_positions[com_id_] = com_target;
             cs_.target_positions[lf_id_]  = lf_ori_init_*lf_traj.block(0, i, 3, 1);
             cs_.target_positions[rf_id_]  = rf_ori_init_*rf_traj.block(0, i, 3, 1);
 
@@ -114,23 +192,61 @@ void Kinematics::Inverse(Eigen::MatrixXd& com_traj,
             cs_.target_orientations[rf_id_] = rf_ori_;
 
             // Inverse kinematics.
-            ik_status_ = RigidBodyDynamics::InverseKinematics(*model_, q_init_, cs_, q_res_);
+            auto start = std::chrono::steady_clock::now();
+            Eigen::VectorXd q_warm = q_init_;
+
+            ik_status_ = RigidBodyDynamics::InverseKinematics(model_, q_init_, cs_, q_res_);
+
+            IKSample sample = Sample();
+
+            // Retry from the seed cache, if the warm start did not converge.
+            if (!ik_status_ && seed_cache_ && !seeded && ApplySeed(key, com_traj.col(i))) {
+
+                RigidBodyDynamics::Utils::CalcCenterOfMass(model_, q_init_, dq_init_, NULL, mass_, com_pos_);
+
+                cs_.body_points[com_id_] = RigidBodyDynamics::CalcBaseToBodyCoordinates(model_, q_init_, chest_body_id_, com_pos_);
+
+                Eigen::VectorXd q_res = q_res_;
+                ik_status_ = RigidBodyDynamics::InverseKinematics(model_, q_init_, cs_, q_res_);
+
+                if (!ik_status_) {
+                    q_res_ = q_res;
+                    sample.iterations += cs_.num_steps;
+                }
+                else {
+                    uint iterations = sample.iterations;
+                    sample = Sample();
+                    sample.iterations += iterations;
+                    q_warm = q_init_;
+                }
+            }
+
+            // Statistics of this column.
+            sample.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            sample.warm_start_dist = (q_res_ - q_warm).norm();
+            stats_.Add(sample);
 
             if (!ik_status_) {
                 //std::cout << "Inverse kinematics did not converge with desired precision." << std::endl;
             }
+            else if (seed_cache_) {
+                StoreSeed(key, com_traj.col(i));
+            }
 
             q_init_ = q_res_;
             q_traj_.col(i) = q_res_;
+
+            // Body point for the next column.
+            UpdateComBodyPoint(q_init_);
         }
     }
     else {
 
         // Take the initial orientation of the model as offset to the orientation of the generated pattern.
-        com_ori_init_ = RigidBodyDynamics::CalcBodyWorldOrientation(*model_, Eigen::VectorXd::Zero(q_init_.size()), model_->GetBodyId("chest"));
-        root_ori_init_ = RigidBodyDynamics::CalcBodyWorldOrientation(*model_, Eigen::VectorXd::Zero(q_init_.size()), model_->GetBodyId("root_link"));
-        lf_ori_init_ = RigidBodyDynamics::CalcBodyWorldOrientation(*model_, Eigen::VectorXd::Zero(q_init_.size()), model_->GetBodyId("l_sole"));
-        rf_ori_init_ = RigidBodyDynamics::CalcBodyWorldOrientation(*model_, Eigen::VectorXd::Zero(q_init_.size()), model_->GetBodyId("r_sole"));
+        com_ori_init_ = RigidBodyDynamics::CalcBodyWorldOrientation(model_, Eigen::VectorXd::Zero(q_init_.size()), chest_body_id_);
+        root_ori_init_ = RigidBodyDynamics::CalcBodyWorldOrientation(model_, Eigen::VectorXd::Zero(q_init_.size()), root_body_id_);
+        lf_ori_init_ = RigidBodyDynamics::CalcBodyWorldOrientation(model_, Eigen::VectorXd::Zero(q_init_.size()), lf_body_id_);
+        rf_ori_init_ = RigidBodyDynamics::CalcBodyWorldOrientation(model_, Eigen::VectorXd::Zero(q_init_.size()), rf_body_id_);
 
         com_eul_init_ = com_ori_init_.eulerAngles(2, 0, 2);
         root_eul_init_ = root_ori_init_.eulerAngles(2, 0, 2);
@@ -165,17 +281,17 @@ void Kinematics::Inverse(Eigen::MatrixXd& com_traj,
                   *Eigen::AngleAxisd(rf_eul_(2), Eigen::Vector3d::UnitZ());
 
         // Add constraints.
-        com_id_ = cs_.AddFullConstraint(model_->GetBodyId("chest"), com_bp_, rf_ori_init_*com_traj.block(0, 0, 3, 1), com_ori_);
-        root_id_ = cs_.AddOrientationConstraint(model_->GetBodyId("root_link"), root_ori_);
-        lf_id_ = cs_.AddFullConstraint(model_->GetBodyId("l_sole"), lf_bp_, lf_ori_init_*lf_traj.block(0, 0, 3, 1), lf_ori_);
-        rf_id_ = cs_.AddFullConstraint(model_->GetBodyId("r_sole"), rf_bp_, rf_ori_init_*rf_traj.block(0, 0, 3, 1), rf_ori_);
+        com_id_ = cs_.AddFullConstraint(chest_body_id_, com_bp_, rf_ori_init_*com_traj.block(0, 0, 3, 1), com_ori_);
+        root_id_ = cs_.AddOrientationConstraint(root_body_id_, root_ori_);
+        lf_id_ = cs_.AddFullConstraint(lf_body_id_, lf_bp_, lf_ori_init_*lf_traj.block(0, 0, 3, 1), lf_ori_);
+        rf_id_ = cs_.AddFullConstraint(rf_body_id_, rf_bp_, rf_ori_init_*rf_traj.block(0, 0, 3, 1), rf_ori_);
 
         // Pre-initialize inverse kinematics.
         for (int i = 0; i < n_init_; i++) {
 
             // Update the angles of the joints q iteratively, such that the body point 
             // represents the real center of mass of the robot.
-            ik_status_ = RigidBodyDynamics::InverseKinematics(*model_, q_init_, cs_, q_res_);
+            ik_status_ = RigidBodyDynamics::InverseKinematics(model_, q_init_, cs_, q_res_);
 
             if (!ik_status_) {
                 std::cout << "Inverse kinematics did not converge with desired precision." << std::endl;
@@ -183,13 +299,297 @@ void Kinematics::Inverse(Eigen::MatrixXd& com_traj,
 
             q_init_ = q_res_;
     
-            RigidBodyDynamics::Utils::CalcCenterOfMass(*model_, q_init_, dq_init_, NULL, mass_, com_pos_);
+            RigidBodyDynamics::Utils::CalcCenterOfMass(model_, q_init_, dq_init_, NULL, mass_, com_pos_);
 
-            cs_.body_points[com_id_] = RigidBodyDynamics::CalcBaseToBodyCoordinates(*model_, q_init_, model_->GetBodyId("chest"), com_pos_);
+            cs_.body_points[com_id_] = RigidBodyDynamics::CalcBaseToBodyCoordinates(model_, q_init_, chest_body_id_, com_pos_);
         }
 
+        com_bp_valid_ = true;
+
         q_traj_.colwise() = q_init_;
 
         initialized_ = true;
     }
 }
+
+
+void Kinematics::InverseBatch(Eigen::MatrixXd& com_traj,
+                              Eigen::MatrixXd& lf_traj,
+                              Eigen::MatrixXd& rf_traj) {
+
+    const int n = com_traj.cols();
+    int start = 0;
+
+    Eigen::MatrixXd com_col;
+    Eigen::MatrixXd lf_col;
+    Eigen::MatrixXd rf_col;
+
+    // Initialize the inverse kinematics on the first column, just like Inverse() does.
+    if (!initialized_) {
+
+        com_col = com_traj.col(0);
+        lf_col = lf_traj.col(0);
+        rf_col = rf_traj.col(0);
+
+        Inverse(com_col, lf_col, rf_col);
+
+        start = 1;
+    }
+
+    // Number of segments, each needs at least a few columns to pay off.
+    uint threads = (batch_threads_ == 0) ? std::thread::hardware_concurrency() : batch_threads_;
+    threads = std::max(1, std::min(int(threads), (n - start)/int(batch_coarse_stride_ + 1)));
+
+    Eigen::VectorXd q_first = q_init_;
+
+    if (threads <= 1) {
+
+        // Not worth splitting, solve sequentially.
+        Eigen::MatrixXd com_seg = com_traj.rightCols(n - start);
+        Eigen::MatrixXd lf_seg = lf_traj.rightCols(n - start);
+        Eigen::MatrixXd rf_seg = rf_traj.rightCols(n - start);
+
+        Eigen::MatrixXd q_traj(model_.dof_count, n);
+
+        if (n - start > 0) {
+            Inverse(com_seg, lf_seg, rf_seg);
+            q_traj.rightCols(n - start) = q_traj_;
+        }
+        if (start == 1) {
+            q_traj.col(0) = q_first;
+        }
+
+        q_traj_ = q_traj;
+
+        return;
+    }
+
+    // Segment boundaries.
+    std::vector<int> seg(threads + 1);
+
+    for (uint k = 0; k <= threads; k++) {
+        seg[k] = start + k*(n - start)/threads;
+    }
+
+    // Coarse sequential pass, which walks along the pattern with a stride and
+    // provides the warm start for every segment.
+    std::vector<Eigen::VectorXd> seeds(threads, q_init_);
+    Kinematics coarse(*this);
+
+    for (uint k = 1; k < threads; k++) {
+
+        for (int i = seg[k - 1] + batch_coarse_stride_; i < seg[k] + int(batch_coarse_stride_); i += batch_coarse_stride_) {
+
+            com_col = com_traj.col(std::min(i, seg[k]));
+            lf_col = lf_traj.col(std::min(i, seg[k]));
+            rf_col = rf_traj.col(std::min(i, seg[k]));
+
+            coarse.Inverse(com_col, lf_col, rf_col);
+        }
+
+        seeds[k] = coarse.q_init_;
+    }
+
+    // Solve the segments in parallel, every thread works on its own copy of the model.
+    std::vector<Kinematics> workers(threads, *this);
+    std::vector<std::thread> pool;
+
+    for (uint k = 0; k < threads; k++) {
+
+        workers[k].SetQInit(seeds[k]);
+        workers[k].stats_.Reset();
+
+        pool.emplace_back([&, k]() {
+
+            Eigen::MatrixXd com_seg = com_traj.middleCols(seg[k], seg[k + 1] - seg[k]);
+            Eigen::MatrixXd lf_seg = lf_traj.middleCols(seg[k], seg[k + 1] - seg[k]);
+            Eigen::MatrixXd rf_seg = rf_traj.middleCols(seg[k], seg[k + 1] - seg[k]);
+
+            workers[k].Inverse(com_seg, lf_seg, rf_seg);
+        });
+    }
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    // Stitch the segments together.
+    Eigen::MatrixXd q_traj(model_.dof_count, n);
+
+    if (start == 1) {
+        q_traj.col(0) = q_first;
+    }
+
+    q_traj.middleCols(seg[0], seg[1] - seg[0]) = workers[0].q_traj_;
+    ik_status_ = workers[0].ik_status_;
+
+    // Check at every boundary, that continuing sequentially from the previous
+    // segment reaches the same solution. Otherwise the segment converged to a
+    // different branch and is solved again, sequentially.
+    Kinematics* last = &workers[0];
+
+    for (uint k = 1; k < threads; k++) {
+
+        Kinematics check(*last);
+
+        com_col = com_traj.col(seg[k]);
+        lf_col = lf_traj.col(seg[k]);
+        rf_col = rf_traj.col(seg[k]);
+
+        check.Inverse(com_col, lf_col, rf_col);
+
+        if ((check.q_traj_.col(0) - workers[k].q_traj_.col(0)).norm() > batch_stitch_tol_) {
+
+            std::cout << "Batch inverse kinematics segment " << k << " did not stitch, solving it sequentially." << std::endl;
+
+            Eigen::MatrixXd com_seg = com_traj.middleCols(seg[k], seg[k + 1] - seg[k]);
+            Eigen::MatrixXd lf_seg = lf_traj.middleCols(seg[k], seg[k + 1] - seg[k]);
+            Eigen::MatrixXd rf_seg = rf_traj.middleCols(seg[k], seg[k + 1] - seg[k]);
+
+            last->Inverse(com_seg, lf_seg, rf_seg);
+        }
+        else {
+
+            last = &workers[k];
+        }
+
+        q_traj.middleCols(seg[k], seg[k + 1] - seg[k]) = last->q_traj_;
+        ik_status_ = ik_status_ && last->ik_status_;
+    }
+
+    q_traj_ = q_traj;
+
+    // Statistics of all workers. The boundary checks are not counted.
+    for (auto& worker : workers) {
+        stats_.Merge(worker.stats_);
+    }
+
+    // Keep the seeds, which the workers found.
+    for (auto& worker : workers) {
+        for (auto& seed : worker.seeds_) {
+
+            if (seeds_.size() >= seed_cache_size_) {
+                break;
+            }
+
+            seeds_.insert(seed);
+        }
+    }
+
+    // Continue from the end of the pattern.
+    SetQInit(last->q_init_);
+}
+
+void Kinematics::UpdateComBodyPoint(Eigen::VectorXd& q) {
+
+    // The inverse kinematics may return through its step tolerance, with the body
+    // transforms of the model one step behind q. Update them once, without
+    // velocities, which is still cheaper than the full center of mass computation.
+    RigidBodyDynamics::UpdateKinematicsCustom(model_, &q, NULL, NULL);
+
+    // Sum up the centers of mass of all bodies. Fixed bodies are already merged
+    // into their movable parents.
+    com_pos_.setZero();
+    mass_ = 0.;
+
+    for (uint i = 1; i < model_.mBodies.size(); i++) {
+
+        const RigidBodyDynamics::Body& body = model_.mBodies[i];
+
+        com_pos_ += body.mMass*(model_.X_base[i].E.transpose()*body.mCenterOfMass + model_.X_base[i].r);
+        mass_ += body.mMass;
+    }
+
+    com_pos_ /= mass_;
+
+    // Express the center of mass in the chest frame, without updating the kinematics again.
+    cs_.body_points[com_id_] = RigidBodyDynamics::CalcBaseToBodyCoordinates(model_, q, chest_body_id_, com_pos_, false);
+
+    com_bp_valid_ = true;
+}
+
+
+IKSample Kinematics::Sample() const {
+
+    IKSample sample;
+
+    sample.iterations = cs_.num_steps;
+    sample.com_residual = Residual(com_id_);
+    sample.root_residual = Residual(root_id_);
+    sample.lf_residual = Residual(lf_id_);
+    sample.rf_residual = Residual(rf_id_);
+    sample.time = 0.;
+    sample.warm_start_dist = 0.;
+    sample.converged = ik_status_;
+
+    return sample;
+}
+
+
+double Kinematics::Residual(uint id) const {
+
+    // Rows of the constraint in the residual of the last iteration.
+    uint begin = cs_.constraint_row_index[id];
+    uint end = (id + 1 < cs_.constraint_row_index.size()) ? cs_.constraint_row_index[id + 1] : cs_.e.size();
+
+    return cs_.e.segment(begin, end - begin).norm();
+}
+
+
+std::vector<int> Kinematics::SeedKey(const Eigen::Vector4d& com, const Eigen::Vector4d& lf, const Eigen::Vector4d& rf) const {
+
+    // Express the feet in the frame of the center of mass, rotated by its yaw,
+    // so that the key does not depend on where the robot walks to.
+    Eigen::Matrix3d rot(Eigen::AngleAxisd(-com(3), Eigen::Vector3d::UnitZ()));
+
+    Eigen::VectorXd rel(8);
+    rel << rot*(lf.head(3) - com.head(3)), rot*(rf.head(3) - com.head(3)), lf(3) - com(3), rf(3) - com(3);
+
+    std::vector<int> key(rel.size());
+
+    for (int i = 0; i < rel.size(); i++) {
+        key[i] = int(std::round(rel(i)/seed_cache_res_));
+    }
+
+    return key;
+}
+
+
+Eigen::Matrix3d Kinematics::SeedFrame(const Eigen::Vector4d& com) const {
+
+    // Same yaw as the key, so that the floating base is applied at any heading.
+    return rf_ori_init_*Eigen::AngleAxisd(com(3), Eigen::Vector3d::UnitZ()).toRotationMatrix();
+}
+
+
+bool Kinematics::ApplySeed(const std::vector<int>& key, const Eigen::Vector4d& com) {
+
+    auto seed = seeds_.find(key);
+
+    if (seed == seeds_.end()) {
+        return false;
+    }
+
+    // Take the joint angles and the relative floating base translation from
+    // the cache, but keep the orientation of the floating base from the warm start.
+    q_init_.head(3) = SeedFrame(com)*seed->second.head(3) + rf_ori_init_*com.head(3);
+    q_init_.tail(q_init_.size() - 6) = seed->second.tail(q_init_.size() - 6);
+
+    com_bp_valid_ = false;
+
+    return true;
+}
+
+
+void Kinematics::StoreSeed(const std::vector<int>& key, const Eigen::Vector4d& com) {
+
+    if (seeds_.size() >= seed_cache_size_ || seeds_.count(key) != 0) {
+        return;
+    }
+
+    // Floating base translation relative to the center of mass target, in the frame of the key.
+    Eigen::VectorXd seed = q_res_;
+    seed.head(3) = SeedFrame(com).transpose()*(q_res_.head(3) - rf_ori_init_*com.head(3));
+
+    seeds_[key] = seed;
+}
@@ -0,0 +1,272 @@
+#include "model_cache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <unistd.h>
+
+// Identification of the cache file.
+const static uint32_t kMagic = 0x4d43484b; // KHCM
+const static uint32_t kVersion = 1;
+
+
+// Helpers to read and write plain data.
+template<typename T>
+void WriteValue(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool ReadValue(std::ifstream& file, T& value) {
+    file.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return bool(file);
+}
+
+template<typename M>
+void WriteMatrix(std::ofstream& file, const M& m) {
+    for (int i = 0; i < m.size(); i++) {
+        WriteValue(file, double(m.data()[i]));
+    }
+}
+
+template<typename M>
+bool ReadMatrix(std::ifstream& file, M& m) {
+    bool ok = true;
+    for (int i = 0; i < m.size(); i++) {
+        ok = ok && ReadValue(file, m.data()[i]);
+    }
+    return ok;
+}
+
+void WriteString(std::ofstream& file, const std::string& s) {
+    WriteValue(file, uint32_t(s.size()));
+    file.write(s.data(), s.size());
+}
+
+bool ReadString(std::ifstream& file, std::string& s) {
+    uint32_t size;
+    if (!ReadValue(file, size)) {
+        return false;
+    }
+    s.resize(size);
+    file.read(&s[0], size);
+    return bool(file);
+}
+
+
+// Joints that can be rebuilt from their type and first axis.
+bool SupportedJoint(const RigidBodyDynamics::Joint& joint) {
+
+    switch (joint.mJointType) {
+        case RigidBodyDynamics::JointTypeRevolute:
+        case RigidBodyDynamics::JointTypePrismatic:
+        case RigidBodyDynamics::JointTypeRevoluteX:
+        case RigidBodyDynamics::JointTypeRevoluteY:
+        case RigidBodyDynamics::JointTypeRevoluteZ:
+        case RigidBodyDynamics::JointTypeHelical:
+        case RigidBodyDynamics::JointTypeSpherical:
+        case RigidBodyDynamics::JointTypeEulerZYX:
+        case RigidBodyDynamics::JointTypeEulerXYZ:
+        case RigidBodyDynamics::JointTypeEulerYXZ:
+        case RigidBodyDynamics::JointTypeTranslationXYZ:
+            return true;
+        default:
+            return false;
+    }
+}
+
+RigidBodyDynamics::Joint BuildJoint(RigidBodyDynamics::JointType type, const RigidBodyDynamics::Math::SpatialVector& axis) {
+
+    switch (type) {
+        case RigidBodyDynamics::JointTypeRevolute:
+            return RigidBodyDynamics::Joint(type, RigidBodyDynamics::Math::Vector3d(axis.head(3)));
+        case RigidBodyDynamics::JointTypePrismatic:
+            return RigidBodyDynamics::Joint(type, RigidBodyDynamics::Math::Vector3d(axis.tail(3)));
+        case RigidBodyDynamics::JointTypeHelical:
+            return RigidBodyDynamics::Joint(axis);
+        default:
+            return RigidBodyDynamics::Joint(type);
+    }
+}
+
+
+uint64_t HashFile(const std::string& file_loc) {
+
+    std::ifstream file(file_loc, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // 64 bit FNV-1a.
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (const char& c : content) {
+        hash ^= uint64_t(uint8_t(c));
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
+
+
+bool ReadModelCache(const std::string& cache_loc, uint64_t hash, RigidBodyDynamics::Model& model, BodyIds& ids) {
+
+    std::ifstream file(cache_loc, std::ios::binary);
+
+    if (!file) {
+        return false;
+    }
+
+    // Check the header.
+    uint32_t magic, version;
+    uint64_t cached_hash;
+
+    if (!ReadValue(file, magic) || !ReadValue(file, version) || !ReadValue(file, cached_hash) ||
+        magic != kMagic || version != kVersion || cached_hash != hash) {
+        return false;
+    }
+
+    // Rebuild the model in a copy, so that a corrupted cache leaves the model untouched.
+    RigidBodyDynamics::Model cached;
+    bool ok = ReadValue(file, ids) && ReadMatrix(file, cached.gravity);
+
+    // Movable bodies, in the order of their id's.
+    uint32_t n_bodies = 0;
+    ok = ok && ReadValue(file, n_bodies);
+
+    for (uint32_t i = 1; ok && i < n_bodies; i++) {
+
+        uint32_t parent, type;
+        uint8_t is_virtual;
+        double mass;
+        std::string name;
+
+        RigidBodyDynamics::Math::Matrix3d E, inertia;
+        RigidBodyDynamics::Math::Vector3d r, com;
+        RigidBodyDynamics::Math::SpatialVector axis;
+
+        ok = ok && ReadValue(file, parent) && ReadMatrix(file, E) && ReadMatrix(file, r)
+                && ReadValue(file, type) && ReadMatrix(file, axis)
+                && ReadValue(file, mass) && ReadMatrix(file, com) && ReadMatrix(file, inertia)
+                && ReadValue(file, is_virtual) && ReadString(file, name);
+
+        if (!ok) {
+            break;
+        }
+
+        RigidBodyDynamics::Body body(mass, com, inertia);
+        body.mIsVirtual = is_virtual;
+
+        ok = cached.AddBody(parent, RigidBodyDynamics::Math::SpatialTransform(E, r),
+                            BuildJoint(RigidBodyDynamics::JointType(type), axis), body, name) == i;
+    }
+
+    // Fixed bodies. Their inertia is already merged into the movable parents.
+    uint32_t n_fixed = 0;
+    ok = ok && ReadValue(file, n_fixed);
+
+    for (uint32_t i = 0; ok && i < n_fixed; i++) {
+
+        RigidBodyDynamics::FixedBody fbody;
+        RigidBodyDynamics::Math::Matrix3d E;
+        RigidBodyDynamics::Math::Vector3d r;
+        std::string name;
+
+        ok = ok && ReadValue(file, fbody.mMovableParent) && ReadMatrix(file, E) && ReadMatrix(file, r)
+                && ReadValue(file, fbody.mMass) && ReadMatrix(file, fbody.mCenterOfMass) && ReadMatrix(file, fbody.mInertia)
+                && ReadString(file, name);
+
+        if (!ok) {
+            break;
+        }
+
+        fbody.mParentTransform = RigidBodyDynamics::Math::SpatialTransform(E, r);
+        fbody.mBaseTransform = RigidBodyDynamics::Math::SpatialTransform();
+
+        cached.mFixedBodies.push_back(fbody);
+        cached.mBodyNameMap[name] = cached.fixed_body_discriminator + i;
+    }
+
+    cached.mFixedJointCount = n_fixed;
+
+    // The body id's need to match the names they were looked up with.
+    ok = ok && cached.GetBodyId("chest") == ids.chest && cached.GetBodyId("root_link") == ids.root
+            && cached.GetBodyId("l_sole") == ids.lf && cached.GetBodyId("r_sole") == ids.rf;
+
+    if (ok) {
+        model = cached;
+    }
+
+    return ok;
+}
+
+
+bool WriteModelCache(const std::string& cache_loc, uint64_t hash, const RigidBodyDynamics::Model& model, const BodyIds& ids) {
+
+    // Only models with joints that can be rebuilt are cached.
+    for (uint i = 1; i < model.mBodies.size(); i++) {
+        if (!SupportedJoint(model.mJoints[i])) {
+            return false;
+        }
+    }
+
+    // Write to a file of this process, and move it into place once it is complete,
+    // so that a crash or a concurrent run never leaves a truncated cache behind.
+    const std::string tmp_loc = cache_loc + ".tmp." + std::to_string(::getpid());
+
+    std::ofstream file(tmp_loc, std::ios::binary | std::ios::trunc);
+
+    if (!file) {
+        return false;
+    }
+
+    // Header.
+    WriteValue(file, kMagic);
+    WriteValue(file, kVersion);
+    WriteValue(file, hash);
+    WriteValue(file, ids);
+    WriteMatrix(file, model.gravity);
+
+    // Movable bodies.
+    WriteValue(file, uint32_t(model.mBodies.size()));
+
+    for (uint i = 1; i < model.mBodies.size(); i++) {
+
+        const RigidBodyDynamics::Body& body = model.mBodies[i];
+
+        WriteValue(file, uint32_t(model.lambda[i]));
+        WriteMatrix(file, model.X_T[i].E);
+        WriteMatrix(file, model.X_T[i].r);
+        WriteValue(file, uint32_t(model.mJoints[i].mJointType));
+        WriteMatrix(file, model.mJoints[i].mJointAxes[0]);
+        WriteValue(file, body.mMass);
+        WriteMatrix(file, body.mCenterOfMass);
+        WriteMatrix(file, body.mInertia);
+        WriteValue(file, uint8_t(body.mIsVirtual));
+        WriteString(file, model.GetBodyName(i));
+    }
+
+    // Fixed bodies.
+    WriteValue(file, uint32_t(model.mFixedBodies.size()));
+
+    for (uint i = 0; i < model.mFixedBodies.size(); i++) {
+
+        const RigidBodyDynamics::FixedBody& fbody = model.mFixedBodies[i];
+
+        WriteValue(file, uint32_t(fbody.mMovableParent));
+        WriteMatrix(file, fbody.mParentTransform.E);
+        WriteMatrix(file, fbody.mParentTransform.r);
+        WriteValue(file, fbody.mMass);
+        WriteMatrix(file, fbody.mCenterOfMass);
+        WriteMatrix(file, fbody.mInertia);
+        WriteString(file, model.GetBodyName(model.fixed_body_discriminator + i));
+    }
+
+    file.close();
+
+    if (!file || std::rename(tmp_loc.c_str(), cache_loc.c_str()) != 0) {
+        std::remove(tmp_loc.c_str());
+        return false;
+    }
+
+    return true;
+}
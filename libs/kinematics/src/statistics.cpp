@@ -0,0 +1,157 @@
+#include "statistics.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+IKStatistics::IKStatistics(uint size, uint iteration_bin, double time_bin, uint bins)
+  : samples_(std::max(size, 1u)),
+    head_(0),
+    size_(0),
+
+    // Histograms.
+    iteration_bin_(std::max(iteration_bin, 1u)),
+    time_bin_(time_bin),
+    iteration_hist_(std::max(bins, 1u), 0),
+    time_hist_(std::max(bins, 1u), 0) {
+
+    Reset();
+}
+
+
+void IKStatistics::Add(const IKSample& sample) {
+
+    // Overwrite the oldest sample, once the buffer is full.
+    samples_[head_] = sample;
+    head_ = (head_ + 1) % samples_.size();
+    size_ = std::min(size_ + 1, uint(samples_.size()));
+
+    // Histograms.
+    uint it_bin = std::min(sample.iterations/iteration_bin_, uint(iteration_hist_.size() - 1));
+    uint t_bin = std::min(uint(sample.time/time_bin_), uint(time_hist_.size() - 1));
+
+    iteration_hist_[it_bin]++;
+    time_hist_[t_bin]++;
+
+    // Aggregates.
+    count_++;
+    failures_ += !sample.converged;
+    iterations_sum_ += sample.iterations;
+    iterations_max_ = std::max(iterations_max_, sample.iterations);
+    time_sum_ += sample.time;
+    time_max_ = std::max(time_max_, sample.time);
+}
+
+
+void IKStatistics::Merge(const IKStatistics& other) {
+
+    // Recent samples of the other instance are appended.
+    for (const auto& sample : other.GetSamples()) {
+
+        samples_[head_] = sample;
+        head_ = (head_ + 1) % samples_.size();
+        size_ = std::min(size_ + 1, uint(samples_.size()));
+    }
+
+    // Histograms and aggregates cover all samples. Histograms of different
+    // shape can not be merged bin by bin.
+    if (other.iteration_hist_.size() == iteration_hist_.size() && other.iteration_bin_ == iteration_bin_ && other.time_bin_ == time_bin_) {
+
+        for (uint i = 0; i < iteration_hist_.size(); i++) {
+            iteration_hist_[i] += other.iteration_hist_[i];
+            time_hist_[i] += other.time_hist_[i];
+        }
+    }
+
+    count_ += other.count_;
+    failures_ += other.failures_;
+    iterations_sum_ += other.iterations_sum_;
+    iterations_max_ = std::max(iterations_max_, other.iterations_max_);
+    time_sum_ += other.time_sum_;
+    time_max_ = std::max(time_max_, other.time_max_);
+}
+
+
+void IKStatistics::Reset() {
+
+    head_ = 0;
+    size_ = 0;
+
+    std::fill(iteration_hist_.begin(), iteration_hist_.end(), 0);
+    std::fill(time_hist_.begin(), time_hist_.end(), 0);
+
+    count_ = 0;
+    failures_ = 0;
+    iterations_sum_ = 0.;
+    iterations_max_ = 0;
+    time_sum_ = 0.;
+    time_max_ = 0.;
+}
+
+
+std::vector<IKSample> IKStatistics::GetSamples() const {
+
+    std::vector<IKSample> samples;
+    samples.reserve(size_);
+
+    uint tail = (head_ + samples_.size() - size_) % samples_.size();
+
+    for (uint i = 0; i < size_; i++) {
+        samples.push_back(samples_[(tail + i) % samples_.size()]);
+    }
+
+    return samples;
+}
+
+
+void IKStatistics::Print(std::ostream& os) const {
+
+    os << "Inverse kinematics statistics over " << count_ << " columns." << std::endl;
+
+    if (count_ == 0) {
+        return;
+    }
+
+    os << "  Failures:   " << failures_ << " (" << 1e2*failures_/count_ << " %)" << std::endl;
+    os << "  Iterations: mean " << iterations_sum_/count_ << ", max " << iterations_max_ << std::endl;
+    os << "  Time:       mean " << 1e3*time_sum_/count_ << " ms, max " << 1e3*time_max_ << " ms" << std::endl;
+
+    // Histograms, with the upper bound of every bin.
+    os << "  Iterations histogram:" << std::endl;
+
+    for (uint i = 0; i < iteration_hist_.size(); i++) {
+
+        if (iteration_hist_[i] == 0) {
+            continue;
+        }
+
+        os << "    " << (i + 1 == iteration_hist_.size() ? ">= " : "<  ") << std::setw(6) << (i + 1 == iteration_hist_.size() ? i : i + 1)*iteration_bin_
+           << ": " << iteration_hist_[i] << std::endl;
+    }
+
+    os << "  Time histogram [ms]:" << std::endl;
+
+    for (uint i = 0; i < time_hist_.size(); i++) {
+
+        if (time_hist_[i] == 0) {
+            continue;
+        }
+
+        os << "    " << (i + 1 == time_hist_.size() ? ">= " : "<  ") << std::setw(6) << 1e3*(i + 1 == time_hist_.size() ? i : i + 1)*time_bin_
+           << ": " << time_hist_[i] << std::endl;
+    }
+}
+
+
+void IKStatistics::WriteCsv(const std::string& path) const {
+
+    std::ofstream file(path.c_str());
+
+    file << "iterations, com_residual, root_residual, lf_residual, rf_residual, time, warm_start_dist, converged\n";
+
+    for (const auto& s : GetSamples()) {
+
+        file << s.iterations << ", " << s.com_residual << ", " << s.root_residual << ", " << s.lf_residual << ", " << s.rf_residual << ", "
+             << s.time << ", " << s.warm_start_dist << ", " << s.converged << "\n";
+    }
+}
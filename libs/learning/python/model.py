@@ -144,6 +144,17 @@ class RGBDCNNLSTM(nn.Module):
 
         b, t, c, h, w = x.size()
         x = x.view(b*t, c, h, w)
+        x = self.encode(x)
+
+        x = x.view(b, t, -1)
+        x = self.temporal(x)
+
+        return x
+
+    def encode(self, x):
+        """
+            Encode frames, NxCxHxW, into embeddings, NxE, independently of each other.
+        """
 
         # Convolutional layers for feature extraction.
         x = self.conv_block1(x)
@@ -153,12 +164,18 @@ class RGBDCNNLSTM(nn.Module):
         x = self.conv_block5(x)
 
         # Flatten.
-        x = x.view(b*t, -1)
+        x = x.view(x.size(0), -1)
 
         # Linear layers for classification.
         x = torch.tanh(self.fc1(x))
         x = torch.tanh(self.fc2(x))
-        x = x.view(b, t, -1)
+
+        return x
+
+    def temporal(self, x):
+        """
+            Predict the velocities from a sequence of embeddings, BxTxE.
+        """
         x, _ = self.rnn(x)
         x = torch.tanh(self.fc3(x))
 
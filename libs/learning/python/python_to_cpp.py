@@ -7,15 +7,77 @@ from model import RGBDCNNLSTM
 batch_size = 1
 sequence_length = 5
 
+# Device of the inference, cpu or cuda, see navigation_inference in libs/io_module/configs.yaml.
+device = torch.device('cpu')
+
+# Additionally export the per-frame encoder and the temporal head as modules of their own,
+# <name>_encoder.pt and <name>_head.pt, for the split inference, which encodes every frame once.
+split = True
+
+
+class Encoder(torch.nn.Module):
+    """
+        Per-frame encoder of a sequence model.
+    """
+    def __init__(self, model):
+        super(Encoder, self).__init__()
+        self.model = model
+
+    def forward(self, x):
+        return self.model.encode(x)
+
+
+class TemporalHead(torch.nn.Module):
+    """
+        Temporal head of a sequence model, on the embeddings of the frames.
+    """
+    def __init__(self, model):
+        super(TemporalHead, self).__init__()
+        self.model = model
+
+    def forward(self, x):
+        return self.model.temporal(x)
+
+
+def optimize(module):
+    """
+        Fold the weights into the graph as constants, and fuse operations for inference,
+        where this version of torch supports it.
+    """
+    if hasattr(torch.jit, 'freeze') and hasattr(torch.jit, 'optimize_for_inference'):
+        module = torch.jit.optimize_for_inference(torch.jit.freeze(module))
+
+    return module
+
+
 # Use torch.jit.trace to generate a torch.jit.ScriptModule via tracing.
 trained_model = UNet(utils.RGBD_INPUT_SHAPE, 2, batch_size)
 # trained_model = RGBDCNNLSTM(utils.RGBD_INPUT_SHAPE, 2)
 
-trained_model.load_state_dict(torch.load('trained_unet_lstm.pt'))
+trained_model.load_state_dict(torch.load('trained_unet_lstm.pt', map_location=device))
 trained_model.eval()
-trained_model.cuda() # already save in eval mode!!!!!!
+trained_model.to(device) # already save in eval mode!!!!!!
 
-example = torch.rand(batch_size, sequence_length, utils.IMAGE_CHANNELS, utils.RESIZED_IMAGE_HEIGHT, utils.RESIZED_IMAGE_WIDTH).cuda()
+example = torch.rand(batch_size, sequence_length, utils.IMAGE_CHANNELS, utils.RESIZED_IMAGE_HEIGHT, utils.RESIZED_IMAGE_WIDTH).to(device)
+
+with torch.no_grad():
+    traced_script_module = optimize(torch.jit.trace(trained_model, example))
 
-traced_script_module = torch.jit.trace(trained_model, example)
 traced_script_module.save('trained_script_module_unet_lstm.pt')
+
+if split:
+    with torch.no_grad():
+        frames = example.view(batch_size*sequence_length, *example.shape[2:])
+        embeddings = trained_model.encode(frames).view(batch_size, sequence_length, -1)
+
+        encoder = optimize(torch.jit.trace(Encoder(trained_model), frames[-1:]))
+        head = optimize(torch.jit.trace(TemporalHead(trained_model), embeddings))
+
+        # The split modules have to reproduce the whole model.
+        split_output = head(torch.cat([encoder(frames[i:i+1]) for i in range(sequence_length)]).view(batch_size, sequence_length, -1))
+
+        if not torch.allclose(split_output, traced_script_module(example), atol=1e-5):
+            raise RuntimeError('Encoder and head do not reproduce the model.')
+
+    encoder.save('trained_script_module_unet_lstm_encoder.pt')
+    head.save('trained_script_module_unet_lstm_head.pt')
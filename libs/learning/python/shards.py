@@ -0,0 +1,257 @@
+import argparse
+import glob
+import os
+import re
+
+import cv2
+import numpy as np
+import pandas as pd
+import torch
+from torch.utils.data import Dataset
+
+import utils
+
+# Layout of the packed binary shards, as written by ShardWriter in
+# libs/vision/include/vision/shard.h. Keep both in line.
+MAGIC = b'BCSHARD1'
+HEADER_SIZE = 128
+HEADER = np.dtype([('magic', 'S8'),
+                   ('version', '<u4'),
+                   ('width', '<u4'),
+                   ('height', '<u4'),
+                   ('channels', '<u4'),
+                   ('vel_dims', '<u4'),
+                   ('capacity', '<u4'),
+                   ('count', '<u8'),
+                   ('rgbd_offset', '<u8'),
+                   ('vel_offset', '<u8'),
+                   ('time_offset', '<u8'),
+                   ('epoch_offset', '<u8')])
+
+
+def align(offset):
+    """
+        Align an offset to 64 bytes.
+    """
+    return (offset + 63) & ~63
+
+
+def open_shard(path):
+    """
+        Memory map a shard.
+    :return:
+        shard: dict
+               Valid records of the arrays rgbd (NxHxWxC, uint8, BGR and disparity),
+               vel (NxV, float32), time (N, int64, milliseconds) and epoch (N, int32).
+    """
+    header = np.fromfile(path, dtype=HEADER, count=1)[0]
+
+    if header['magic'] != MAGIC:
+        raise ValueError('{} is not a shard.'.format(path))
+
+    n, cap = int(header['count']), int(header['capacity'])
+    h, w, c, v = int(header['height']), int(header['width']), int(header['channels']), int(header['vel_dims'])
+
+    return {'rgbd': np.memmap(path, np.uint8, 'r', int(header['rgbd_offset']), (cap, h, w, c))[:n],
+            'vel': np.memmap(path, '<f4', 'r', int(header['vel_offset']), (cap, v))[:n],
+            'time': np.memmap(path, '<i8', 'r', int(header['time_offset']), (cap,))[:n],
+            'epoch': np.memmap(path, '<i4', 'r', int(header['epoch_offset']), (cap,))[:n]}
+
+
+class ShardWriter(object):
+    def __init__(self, shard_dir, width, height, vel_dims, channels=4, capacity=1024):
+        """
+            Append records to shards in shard_dir, and list the
+            finished shards with their count in index.txt.
+        """
+        self.shard_dir = shard_dir
+        self.width, self.height, self.channels = width, height, channels
+        self.vel_dims = vel_dims
+        self.capacity = capacity
+        self.shards = 0
+        self.shard = None
+
+        os.makedirs(shard_dir, exist_ok=True)
+
+    def append(self, rgbd, vel, time, epoch):
+        """
+            Append a record, rgbd of shape HxWxC.
+        """
+        if self.shard is None:
+            self.open()
+
+        n = int(self.header['count'][0])
+
+        self.rgbd[n] = rgbd
+        self.vel[n] = vel
+        self.time[n] = time
+        self.epoch[n] = epoch
+
+        self.header['count'] = n + 1
+
+        if n + 1 == self.capacity:
+            self.close()
+
+    def open(self):
+        """
+            Open and allocate a new shard, after the existing ones.
+        """
+        while os.path.exists(self.path()):
+            self.shards += 1
+
+        cap, h, w, c, v = self.capacity, self.height, self.width, self.channels, self.vel_dims
+
+        vel_offset = align(HEADER_SIZE + cap*h*w*c)
+        time_offset = align(vel_offset + cap*v*4)
+        epoch_offset = align(time_offset + cap*8)
+        end = align(epoch_offset + cap*4)
+
+        with open(self.path(), 'wb') as f:
+            f.truncate(end)
+
+        self.shard = np.memmap(self.path(), np.uint8, 'r+', 0, (end,))
+        self.header = self.shard[:HEADER.itemsize].view(HEADER)
+        self.header[0] = (MAGIC, 1, w, h, c, v, cap, 0, HEADER_SIZE, vel_offset, time_offset, epoch_offset)
+
+        self.rgbd = self.shard[HEADER_SIZE:HEADER_SIZE + cap*h*w*c].reshape(cap, h, w, c)
+        self.vel = self.section('vel_offset', '<f4', cap*v).reshape(cap, v)
+        self.time = self.section('time_offset', '<i8', cap)
+        self.epoch = self.section('epoch_offset', '<i4', cap)
+
+    def section(self, name, dtype, n):
+        """
+            View of an array of the shard, at the offset name.
+        """
+        offset = int(self.header[name][0])
+        return self.shard[offset:offset + n*np.dtype(dtype).itemsize].view(dtype)
+
+    def close(self):
+        """
+            Finish the current shard.
+        """
+        if self.shard is None:
+            return
+
+        count = int(self.header['count'][0])
+
+        self.shard.flush()
+        del self.rgbd, self.vel, self.time, self.epoch, self.header
+        self.shard = None
+
+        with open(os.path.join(self.shard_dir, 'index.txt'), 'a') as f:
+            f.write('{}, {}\n'.format(os.path.basename(self.path()), count))
+
+        self.shards += 1
+
+    def path(self):
+        return os.path.join(self.shard_dir, 'shard_{:05d}.bin'.format(self.shards))
+
+
+class ShardDataSet(Dataset):
+    def __init__(self, data_dir, sequence_length=1, vel_indices=(0, 2)):
+        """
+            Memory map all shards in data_dir/data/shards. With a
+            sequence length above one, samples are sequences of
+            records within the same epoch.
+        """
+        paths = sorted(glob.glob(os.path.join(data_dir, 'data', 'shards', 'shard_*.bin')))
+        shards = [open_shard(p) for p in paths]
+        shards = [s for s in shards if len(s['time']) > 0]
+
+        if not shards:
+            raise ValueError('No shards in {}.'.format(data_dir))
+
+        self.shards = shards
+        self.sequence_length = sequence_length
+        self.vel_indices = list(vel_indices)
+
+        # Global index of the records, and the records, which end a sequence.
+        self.locations = np.concatenate([np.stack([np.full(len(s['time']), i), np.arange(len(s['time']))], 1) for i, s in enumerate(shards)])
+        epochs = np.concatenate([s['epoch'] for s in shards])
+
+        valid = np.arange(len(epochs)) >= sequence_length - 1
+        for i in range(1, sequence_length):
+            valid[i:] &= epochs[i:] == epochs[:-i]
+
+        self.indices = np.nonzero(valid)[0]
+
+    def record(self, index):
+        """
+            Normalized CxHxW image and velocity of a record.
+        """
+        shard, row = self.locations[index]
+        s = self.shards[shard]
+
+        img = np.transpose(s['rgbd'][row], (2, 0, 1))
+        img = utils.normalize(img.astype(np.float32))
+        vel = s['vel'][row][self.vel_indices]
+
+        return img, vel
+
+    def __getitem__(self, index):
+        """
+            Get an image and the velocity, or sequences of them, TxCxHxW.
+        """
+        index = self.indices[index]
+
+        if self.sequence_length == 1:
+            img, vel = self.record(index)
+            return {'img': torch.from_numpy(img).float(),
+                    'vel': torch.from_numpy(vel).float()}
+
+        imgs, vels = zip(*[self.record(index + i) for i in range(-self.sequence_length + 1, 1)])
+
+        return {'imgs': torch.from_numpy(np.array(imgs)).float(),
+                'vels': torch.from_numpy(np.array(vels)).float()}
+
+    def __len__(self):
+        """
+            Return the length of the whole data set.
+        """
+        return len(self.indices)
+
+
+def convert(data_dir, width, height, capacity):
+    """
+        Convert a dataset of images and log.txt into shards in
+        data_dir/data/shards, at the network input of width x height.
+    """
+    data_df = pd.read_csv(os.path.join(data_dir, 'log.txt'),
+                          delimiter=', ',
+                          names=['left', 'wls_disp', 'vel0', 'vel1', 'vel2'],
+                          engine='python')
+
+    writer = ShardWriter(os.path.join(data_dir, 'data', 'shards'), width, height, 3, capacity=capacity)
+
+    for i, row in enumerate(data_df.itertuples()):
+
+        img_left, img_wls_disp = utils.load_rgbd(data_dir, row.left, row.wls_disp)
+
+        if img_left is None or img_wls_disp is None:
+            print('Skipping {}, could not read its images.'.format(row.left))
+            continue
+
+        img_left = cv2.resize(utils.crop(img_left), (width, height), interpolation=cv2.INTER_AREA)
+        img_wls_disp = cv2.resize(utils.crop(img_wls_disp), (width, height), interpolation=cv2.INTER_AREA)
+
+        # Epoch and time stamp from the name, left_epoch_<epoch>_<time>.jpg.
+        match = re.search(r'epoch_(\d+)_(\d+)\.jpg', row.left)
+        epoch, time = (int(match.group(1)), int(match.group(2))) if match else (0, i)
+
+        writer.append(np.dstack([img_left, img_wls_disp]), [row.vel0, row.vel1, row.vel2], time, epoch)
+
+    writer.close()
+
+    print('Converted {} records into {} shards.'.format(len(data_df), writer.shards))
+
+
+if __name__ == '__main__':
+
+    parser = argparse.ArgumentParser(description='Convert a dataset of images and log.txt into packed binary shards.')
+    parser.add_argument('--data_dir', type=str, required=True, help='Location of log.txt and data/img.')
+    parser.add_argument('--width', type=int, default=80, help='Width of the network input.')
+    parser.add_argument('--height', type=int, default=60, help='Height of the network input.')
+    parser.add_argument('--capacity', type=int, default=1024, help='Records per shard.')
+    args = parser.parse_args()
+
+    convert(args.data_dir, args.width, args.height, args.capacity)
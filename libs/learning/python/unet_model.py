@@ -47,18 +47,34 @@ class UNet(nn.Module):
     def forward(self, x):
         b, t, c, h, w = x.size()
         x = x.view(b*t, c, h, w)
+        x = self.encode(x)
+
+        x = x.view(b, t, -1)
+        x = self.temporal(x)
+        
+        return x
+
+    def encode(self, x):
+        """
+            Encode frames, NxCxHxW, into embeddings, NxE, independently of each other.
+        """
         x = self.forward_skip(x)
 
         # Flatten.
         #x = x.view(b*t, int(x.numel()/(b*t)))
-        x = x.view(b*t, -1)
+        x = x.view(x.size(0), -1)
         x = torch.relu(self.fc1(x))
         x = torch.relu(self.fc2(x))
 
-        x = x.view(b, t, -1)
+        return x
+
+    def temporal(self, x):
+        """
+            Predict the velocity from a sequence of embeddings, BxTxE.
+        """
         x, (h_c, h_c) = self.rnn(x)
         x = torch.tanh(self.fc3(x[:, -1, :]))
-        
+
         return x
 
 
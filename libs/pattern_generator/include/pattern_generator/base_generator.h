@@ -80,6 +80,8 @@ public:
 
     PatternGeneratorState Update(double dt);
 
+    PatternGeneratorState Predict(const PatternGeneratorState& state, double dt) const;
+
     void InitializeConstantMatrices();
 
     void InitializeCopMatrices();
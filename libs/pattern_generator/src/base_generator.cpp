@@ -1,5 +1,6 @@
 #include "base_generator.h"
 #include <iostream>
+#include <cmath>
 
 BaseGenerator::BaseGenerator(const std::string config_file_loc)
     : // Configurations
@@ -458,6 +459,36 @@ PatternGeneratorState BaseGenerator::Update(double dt) {
   return {c_k_x_0, c_k_y_0, h_com_0_, f_k_x_0_, f_k_y_0_, f_k_q_0_temp, current_support_.foot, c_k_q_0};
 }
 
+PatternGeneratorState BaseGenerator::Predict(const PatternGeneratorState& state, double dt) const {
+  // Predict the center of mass dt seconds ahead with the linear
+  // inverted pendulum, for a cop that stays where it is, e.g. to
+  // compensate the latency between a measurement and the time the
+  // pattern, which starts from it, is applied.
+  PatternGeneratorState predicted = state;
+
+  if (dt <= 0.) {
+    return predicted;
+  }
+
+  double w = std::sqrt(g_/state.com_z);
+  double c = std::cosh(w*dt);
+  double s = std::sinh(w*dt);
+
+  // Cop and resulting com trajectory.
+  //   c(t) = z + (c0 - z) cosh(wt) + dc0/w sinh(wt)
+  double z_x = state.com_x(0) - state.com_z/g_*state.com_x(2);
+  double z_y = state.com_y(0) - state.com_z/g_*state.com_y(2);
+
+  predicted.com_x(0) = z_x + (state.com_x(0) - z_x)*c + state.com_x(1)/w*s;
+  predicted.com_y(0) = z_y + (state.com_y(0) - z_y)*c + state.com_y(1)/w*s;
+  predicted.com_x(1) = (state.com_x(0) - z_x)*w*s + state.com_x(1)*c;
+  predicted.com_y(1) = (state.com_y(0) - z_y)*w*s + state.com_y(1)*c;
+  predicted.com_x(2) = w*w*(predicted.com_x(0) - z_x);
+  predicted.com_y(2) = w*w*(predicted.com_y(0) - z_y);
+
+  return predicted;
+}
+
 void BaseGenerator::InitializeConstantMatrices() {
   for (int i = 0; i < n_; i++) {
     const int n = i + 1;
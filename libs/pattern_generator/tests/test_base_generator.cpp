@@ -0,0 +1,109 @@
+#include "gtest/gtest.h"
+#include <cmath>
+#include <Eigen/Dense>
+
+#include "nmpc_generator.h"
+#include "utils.h"
+
+// The fixture for testing the prediction of the class BaseGenerator.
+class BaseGeneratorTest : public ::testing::Test   {
+    protected:
+
+    // Constructor.
+    BaseGeneratorTest() {
+      // Initialize a generator, which implements BaseGenerator.
+      generator_ = new NMPCGenerator();
+
+      // A com, which moves and accelerates away from its cop.
+      pg_state_ = {Eigen::Vector3d(0.01, 0.1, 0.2),
+                   Eigen::Vector3d(-0.02, -0.05, 0.1),
+                   generator_->Hcom(),
+                   generator_->Fkx0(),
+                   generator_->Fky0(),
+                   generator_->Fkq0(),
+                   generator_->CurrentSupport().foot,
+                   generator_->Ckq0()};
+    }
+
+    // Destructor.
+    virtual ~BaseGeneratorTest() {
+      delete generator_;
+    }
+
+    // Member variables.
+    PatternGeneratorState pg_state_;
+
+    // Generator.
+    NMPCGenerator* generator_;
+};
+
+
+// Test that the state is kept for no latency.
+TEST_F(BaseGeneratorTest, PredictZero) {
+    PatternGeneratorState predicted = generator_->Predict(pg_state_, 0.);
+
+    EXPECT_TRUE(predicted.com_x.isApprox(pg_state_.com_x));
+    EXPECT_TRUE(predicted.com_y.isApprox(pg_state_.com_y));
+    EXPECT_EQ(predicted.com_z, pg_state_.com_z);
+}
+
+
+// Test that a com at rest above its cop stays there.
+TEST_F(BaseGeneratorTest, PredictRest) {
+    pg_state_.com_x << 0.05, 0., 0.;
+    pg_state_.com_y << -0.02, 0., 0.;
+
+    PatternGeneratorState predicted = generator_->Predict(pg_state_, 0.1);
+
+    EXPECT_NEAR((predicted.com_x - pg_state_.com_x).norm(), 0., 1e-12);
+    EXPECT_NEAR((predicted.com_y - pg_state_.com_y).norm(), 0., 1e-12);
+}
+
+
+// Test the prediction against an integration of the linear inverted
+// pendulum, com'' = g/h (com - cop), with the cop held where it is.
+TEST_F(BaseGeneratorTest, PredictPendulum) {
+    const double dt = 0.05;
+    const double w2 = generator_->G()/pg_state_.com_z;
+
+    PatternGeneratorState predicted = generator_->Predict(pg_state_, dt);
+
+    for (int d = 0; d < 2; d++) {
+
+        const Eigen::Vector3d& c0 = d == 0 ? pg_state_.com_x : pg_state_.com_y;
+        const Eigen::Vector3d& c1 = d == 0 ? predicted.com_x : predicted.com_y;
+
+        double cop = c0(0) - c0(2)/w2;
+        double c = c0(0);
+        double dc = c0(1);
+
+        // Fourth order Runge-Kutta.
+        const int steps = 1000;
+        const double h = dt/steps;
+
+        for (int i = 0; i < steps; i++) {
+            double k1c = dc,               k1v = w2*(c - cop);
+            double k2c = dc + 0.5*h*k1v,   k2v = w2*(c + 0.5*h*k1c - cop);
+            double k3c = dc + 0.5*h*k2v,   k3v = w2*(c + 0.5*h*k2c - cop);
+            double k4c = dc + h*k3v,       k4v = w2*(c + h*k3c - cop);
+
+            c  += h/6.*(k1c + 2.*k2c + 2.*k3c + k4c);
+            dc += h/6.*(k1v + 2.*k2v + 2.*k3v + k4v);
+        }
+
+        EXPECT_NEAR(c1(0), c, 1e-9);
+        EXPECT_NEAR(c1(1), dc, 1e-9);
+        EXPECT_NEAR(c1(2), w2*(c - cop), 1e-8);
+    }
+}
+
+
+// Test that predicting in two steps equals predicting at once, since
+// the cop is kept by the prediction.
+TEST_F(BaseGeneratorTest, PredictComposition) {
+    PatternGeneratorState once = generator_->Predict(pg_state_, 0.08);
+    PatternGeneratorState twice = generator_->Predict(generator_->Predict(pg_state_, 0.03), 0.05);
+
+    EXPECT_NEAR((once.com_x - twice.com_x).norm(), 0., 1e-12);
+    EXPECT_NEAR((once.com_y - twice.com_y).norm(), 0., 1e-12);
+}
@@ -0,0 +1,151 @@
+#ifndef VISION_DATASET_WRITER_H_
+#define VISION_DATASET_WRITER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include "realtime.h"
+#include "shard.h"
+
+// Settings of the dataset writer.
+struct DatasetWriterConfigs {
+
+    // Number of records, which may wait for their images to be written.
+    int queue_size;
+
+    // Threads, which encode and write the images.
+    int threads;
+
+    // Quality of the JPEG images, 0 to 100.
+    int jpeg_quality;
+
+    // Format of the dataset, jpeg for images and log.txt, or shards for packed
+    // binary shards in data/shards.
+    std::string format;
+
+    // Crop of the full resolution images, and the size of the network input,
+    // at which the shards keep them, and records per shard.
+    cv::Rect shard_crop;
+    cv::Size shard_size;
+    int shard_capacity;
+};
+
+// Read the settings from the dataset_writer node of the configurations.
+DatasetWriterConfigs ReadDatasetWriterConfigs(const YAML::Node& configs);
+
+
+// A sample of the dataset, images and the commanded velocity.
+struct DatasetRecord {
+    int epoch;
+    long time_stamp;         // milliseconds since the start of the recording
+    cv::Mat left;            // left image
+    cv::Mat disparity;       // disparity image
+    std::vector<double> vel; // commanded velocity
+    cv::Rect crop;           // region of the images, which the shards keep, empty for all
+};
+
+
+// DatasetWriter stores records of a dataset from a pool of threads,
+// so that disk latency does not stall the capture. Each record's
+// images are encoded to JPEG and written to data/img, and the record
+// is appended to log.txt through a single, buffered file handle. The
+// log keeps the order of the records, and only lists records whose
+// images are on disk. Alternatively, the threads crop and resize the
+// images to the network input, and the records are appended to packed
+// binary shards in order. Records, which find the queue full, are
+// dropped and reported.
+class DatasetWriter
+{
+    public:
+
+        DatasetWriter(const std::string& out_location, const DatasetWriterConfigs& configs,
+                      const RealtimeConfigs& rt_configs = RealtimeConfigs());
+
+        // Writes all pending records.
+        ~DatasetWriter();
+
+        // Producer. The images are referenced, not copied, so they must not be
+        // written to afterwards. Returns false and drops the record, if the queue is full.
+        bool Push(const DatasetRecord& record);
+
+        // Write all pending records and stop the threads.
+        void Close();
+
+        // Getters.
+        inline uint64_t GetWritten() const { return written_.load(std::memory_order_relaxed); };
+        inline uint64_t GetDropped() const { return dropped_.load(std::memory_order_relaxed); };
+        inline uint64_t GetFailed()  const { return failed_.load(std::memory_order_relaxed);  };
+        inline const DatasetWriterConfigs& GetConfigs() const { return configs_; };
+
+        // Print written, dropped and failed records.
+        void Print(std::ostream& os = std::cout) const;
+
+    private:
+
+        enum State { FREE, QUEUED, ENCODING, DONE };
+
+        // Slot of the queue, with the buffers of the encoded images.
+        struct Slot {
+            State state;
+            bool ok;
+            DatasetRecord record;
+            std::vector<unsigned char> left_jpg;
+            std::vector<unsigned char> disparity_jpg;
+            cv::Mat left_small;
+            cv::Mat disparity_small;
+            cv::Mat rgbd;
+        };
+
+        // Thread of the pool, which encodes and writes the images of records.
+        void Run();
+
+        // Encode an image and write it to out_location/path.
+        bool WriteImage(const cv::Mat& img, std::vector<unsigned char>& buf, const std::string& path);
+
+        // Crop and resize the images of a record to the network input, into one BGR and disparity image.
+        bool PackImages(Slot& slot);
+
+        // Append the records, whose images are written or packed, to the log or the shards, in order.
+        void WriteLog();
+
+        const std::string out_location_;
+        const DatasetWriterConfigs configs_;
+        const RealtimeConfigs rt_configs_;
+        const std::vector<int> jpeg_params_;
+
+        // Single log handle, with a buffer of its own.
+        std::ofstream log_;
+        std::vector<char> log_buf_;
+        std::mutex log_mutex_;
+
+        // Shards, if they are the format.
+        const bool shards_;
+        std::unique_ptr<ShardWriter> shard_writer_;
+
+        // Queue of records. Records are added at head, encoded from next and logged from tail.
+        std::vector<Slot> slots_;
+        uint64_t head_;
+        uint64_t next_;
+        uint64_t tail_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::vector<std::thread> threads_;
+
+        bool running_;
+        std::atomic<uint64_t> written_;
+        std::atomic<uint64_t> dropped_;
+        std::atomic<uint64_t> failed_;
+        double t_warned_;
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef VISION_REMAP_H_
+#define VISION_REMAP_H_
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Rectify a color image with the fixed-point maps of initUndistortRectifyMap,
+// CV_16SC2 and CV_16UC1, and convert it to gray, in a single pass over the rows
+// [begin, end) of the output. The maps may sample a smaller output than the
+// input, so that the image is downsampled in the same pass. Sampling reads 2x2
+// pixels, so below a scale of 0.75, MIN_FUSED_SCALE of stereo.h, pixels are skipped. The outputs have to
+// be allocated with the size of the maps, as CV_8UC3 and CV_8UC1. Pixels, which
+// map outside of the input, are black.
+void RemapColorGray(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2,
+                    cv::Mat& rgb, cv::Mat& gray, int begin, int end);
+
+// Take a buffer of the pool, which nobody else references anymore, or add one.
+cv::Mat TakeBuffer(std::vector<cv::Mat>& pool, const cv::Size& size, int type);
+
+#endif
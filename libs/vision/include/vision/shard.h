@@ -0,0 +1,89 @@
+#ifndef VISION_SHARD_H_
+#define VISION_SHARD_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Header at the start of each shard, little endian. The arrays start at their
+// offsets, aligned to 64 bytes, and hold capacity records, of which the first
+// count are valid:
+//   rgbd  uint8   [capacity][height][width][channels], BGR and disparity
+//   vel   float32 [capacity][vel_dims]
+//   time  int64   [capacity], milliseconds since the start of the recording
+//   epoch int32   [capacity]
+// Keep in line with libs/learning/python/shards.py.
+struct ShardHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t vel_dims;
+    uint32_t capacity;
+    uint64_t count;
+    uint64_t rgbd_offset;
+    uint64_t vel_offset;
+    uint64_t time_offset;
+    uint64_t epoch_offset;
+};
+
+// Bytes reserved for the header.
+const uint64_t SHARD_HEADER_SIZE = 128;
+
+static_assert(sizeof(ShardHeader) <= SHARD_HEADER_SIZE, "Shard header exceeds its reserved size.");
+
+
+// ShardWriter appends records of fixed size to packed binary shards,
+// shard_<n>.bin, in a directory, so that datasets can be memory
+// mapped instead of opening and decoding an image per record. Each
+// shard is allocated with room for capacity records, and the count
+// in its header is updated with every record. Shards, which are full
+// or closed, are listed with their count in index.txt.
+class ShardWriter
+{
+    public:
+
+        // Records hold images of size, with channels channels.
+        ShardWriter(const std::string& dir, const cv::Size& size, int channels = 4, int capacity = 1024);
+
+        // Finishes the current shard.
+        ~ShardWriter();
+
+        // Append a record. The image has to be of the size and channels of the
+        // shards, and all velocities of the same length. Returns false on failure.
+        bool Append(const cv::Mat& rgbd, const std::vector<double>& vel, int64_t time, int32_t epoch);
+
+        // Finish the current shard, the next record opens a new one.
+        void Close();
+
+        // Getters.
+        inline int      GetShards()  const { return shards_;  };
+        inline uint64_t GetRecords() const { return records_; };
+
+    private:
+
+        // Open and allocate a new shard.
+        bool Open(int vel_dims);
+
+        // Update the count of the current shard, and list it in the index.
+        void Finish();
+
+        const std::string dir_;
+        const cv::Size size_;
+        const int channels_;
+        const int capacity_;
+
+        // Current shard.
+        std::fstream file_;
+        std::string name_;
+        ShardHeader header_;
+        std::vector<float> vel_;
+
+        int shards_;
+        uint64_t records_;
+};
+
+#endif
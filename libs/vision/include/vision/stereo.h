@@ -0,0 +1,172 @@
+#ifndef VISION_STEREO_H_
+#define VISION_STEREO_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <opencv2/ximgproc/disparity_filter.hpp>
+
+#include "mailbox.h"
+#include "pipeline.h"
+#include "realtime.h"
+#include "tick_statistics.h"
+
+// Settings of the stereo matching.
+struct StereoConfigs {
+
+    // Block matching, at full resolution.
+    int num_disparities;
+    int block_size;
+
+    // Scale of the images, at which they are matched. Below 1, the pairs are
+    // downsampled right after the rectification, and the disparity range and
+    // block size are scaled along. Down to MIN_FUSED_SCALE, the rectification
+    // samples at the scale of the matching, below it, the pairs are rectified at
+    // full resolution and downsampled by area.
+    double scale;
+
+    // Weighted least squares filter.
+    double lambda;
+    double sigma_color;
+
+    // Nominal period of the pairs. Disparities, which take longer, miss their deadline.
+    double period;
+};
+
+// Smallest scale, at which the rectification samples at the scale of the matching.
+// Bilinear sampling reads 2x2 pixels, so below it, some pixels are skipped and fine
+// texture aliases.
+const double MIN_FUSED_SCALE = 0.75;
+
+// Read the settings from the stereo node of the configurations.
+StereoConfigs ReadStereoConfigs(const YAML::Node& configs);
+
+
+// Filtered disparity of a stereo pair.
+struct StereoFrame {
+    double time;             // time stamp of the pair
+    cv::Mat left;            // rectified left image, at the scale of the matching
+    cv::Mat disparity;       // filtered disparity, normalized to 8 bit
+    std::vector<double> vel; // commanded velocity, when the pair was pushed
+    int epoch;               // epoch, when the pair was pushed
+};
+
+
+// StereoPipeline computes the disparity of stereo pairs in stages.
+// Push rectifies the left and the right image in parallel, in a
+// single pass, which also downsamples and converts them to gray,
+// into buffers that are reused once no stage needs them. Pairs,
+// which are downsampled further than bilinear sampling covers,
+// are rectified at full resolution and downsampled by area. A match
+// stage runs the left and the right matcher concurrently, and a
+// filter stage applies the weighted least squares filter, while
+// the match stage already works on the next pair. Every stage
+// takes the latest pair, which replaces the one waiting for it,
+// so that stages, which do not keep up, skip the older pairs.
+// Each pair carries the velocity and the epoch, which were current
+// when it was pushed, to its disparity.
+class StereoPipeline
+{
+    public:
+
+        // Images are rectified with the calibration, unless rectify is false, e.g. in simulation.
+        StereoPipeline(const std::string& calib_file, bool rectify, const StereoConfigs& configs,
+                       const RealtimeConfigs& rt_configs = RealtimeConfigs());
+
+        ~StereoPipeline();
+
+        void Start();
+
+        void Stop();
+
+        // Rectify a pair and hand it to the matching. The images are copied, so
+        // they may be views into memory of a port, or shared memory. Before the
+        // pair is handed over, valid() is asked whether the input is still intact.
+        // The velocity and the epoch label the pair. Returns false, if the pair is dropped.
+        bool Push(const cv::Mat& left, const cv::Mat& right, double time,
+                  const std::vector<double>& vel = std::vector<double>(), int epoch = 0,
+                  const std::function<bool()>& valid = std::function<bool()>());
+
+        // Take the latest disparity, returns false if there is no new one.
+        bool Pop(StereoFrame& frame);
+
+        // Getters.
+        inline double GetScale()          const { return configs_.scale; };
+        inline int    GetNumDisparities() const { return l_matcher_->getNumDisparities(); };
+        inline int    GetBlockSize()      const { return l_matcher_->getBlockSize(); };
+        inline const TickStatistics& GetLatency() const { return latency_; };
+        inline uint64_t GetPushed() const { return pushed_; };
+        inline uint64_t GetDone()   const { return done_;   };
+
+        // Scale a crop of the full resolution images to images of size at the scale of
+        // the matching. The crop leaves out at least the border, where the disparity has no values.
+        cv::Rect ScaleCrop(const cv::Rect& crop, const cv::Size& size) const;
+
+        // Print latency from the time stamp of a pair to its disparity, throughput and drops.
+        void Print(std::ostream& os = std::cout) const;
+
+    private:
+
+        // Work item of the stages.
+        struct Item {
+            double time;
+            std::vector<double> vel;
+            int epoch;
+            cv::Mat left;
+            cv::Mat right;
+            cv::Mat left_gray;
+            cv::Mat right_gray;
+            cv::Mat left_disp;
+            cv::Mat right_disp;
+            cv::Mat disparity;
+        };
+
+        // Rectify an image, if configured, into out, downsample and convert it to gray.
+        // Used for images, which are not covered by RemapColorGray. Maps at full
+        // resolution rectify into full, which is downsampled by area.
+        void Rectify(const cv::Mat& in, cv::Mat& out, cv::Mat& gray, cv::Mat& full, const cv::Mat& map1, const cv::Mat& map2);
+
+        bool Match(Item& item);
+
+        bool Filter(Item& item);
+
+        bool rectify_;
+        StereoConfigs configs_;
+        RealtimeConfigs rt_configs_;
+
+        // Calibration, and fixed-point rectification maps for the size of the pairs, which also
+        // downsample, if fused_, or sample at full resolution into lfull_ and rfull_ otherwise.
+        cv::Mat K1_, K2_, D1_, D2_, R1_, R2_, P1_, P2_;
+        cv::Mat lmap1_, lmap2_, rmap1_, rmap2_;
+        cv::Mat lfull_, rfull_;
+        cv::Size size_;
+        cv::Size scaled_size_;
+        bool fused_;
+
+        // Buffers of the rectified images.
+        std::vector<cv::Mat> pool_;
+
+        // Matchers, the filter is used by its stage only.
+        cv::Ptr<cv::StereoBM> l_matcher_;
+        cv::Ptr<cv::StereoMatcher> r_matcher_;
+        cv::Ptr<cv::ximgproc::DisparityWLSFilter> wls_;
+
+        // Stages, and their results.
+        Pipeline<Item> pipeline_;
+        Item item_;
+
+        Mailbox<StereoFrame> frames_;
+        StereoFrame frame_;
+
+        // Statistics.
+        TickStatistics latency_;
+        std::atomic<double> t_start_;
+        std::atomic<double> t_done_;
+        std::atomic<uint64_t> pushed_;
+        std::atomic<uint64_t> done_;
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "dataset_writer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <yarp/os/all.h>
+
+DatasetWriterConfigs ReadDatasetWriterConfigs(const YAML::Node& configs) {
+
+    const YAML::Node node = configs["dataset_writer"];
+
+    std::vector<int> crop = node["shard_crop"].as<std::vector<int>>();
+    std::vector<int> size = node["shard_size"].as<std::vector<int>>();
+
+    if (crop.size() != 4 || size.size() != 2) {
+        std::cerr << "Shard crop needs x, y, width and height, and shard size width and height." << std::endl;
+        std::exit(1);
+    }
+
+    return {node["queue_size"].as<int>(),
+            node["threads"].as<int>(),
+            node["jpeg_quality"].as<int>(),
+            node["format"].as<std::string>(),
+            cv::Rect(crop[0], crop[1], crop[2], crop[3]),
+            cv::Size(size[0], size[1]),
+            node["shard_capacity"].as<int>()};
+}
+
+
+// Implement DatasetWriter.
+DatasetWriter::DatasetWriter(const std::string& out_location, const DatasetWriterConfigs& configs, const RealtimeConfigs& rt_configs)
+  : out_location_(out_location),
+    configs_(configs),
+    rt_configs_(rt_configs),
+    jpeg_params_({cv::IMWRITE_JPEG_QUALITY, configs.jpeg_quality}),
+    log_buf_(1 << 16),
+    shards_(configs.format == "shards"),
+    slots_(std::max(1, configs.queue_size)),
+    head_(0),
+    next_(0),
+    tail_(0),
+    running_(true),
+    written_(0),
+    dropped_(0),
+    failed_(0),
+    t_warned_(0.) {
+
+    if (configs_.threads < 1) {
+        std::cerr << "Dataset writer needs at least one thread." << std::endl;
+        std::exit(1);
+    }
+
+    if (shards_) {
+
+        // Images at the network input, BGR and disparity.
+        shard_writer_.reset(new ShardWriter(out_location_ + "/data/shards", configs_.shard_size, 4, configs_.shard_capacity));
+    }
+    else if (configs_.format == "jpeg") {
+
+        // The buffer has to be set before the file is opened.
+        log_.rdbuf()->pubsetbuf(log_buf_.data(), log_buf_.size());
+        log_.open(out_location_ + "/log.txt", std::ios_base::app);
+
+        if (!log_.is_open()) {
+            std::cerr << "Could not open " << out_location_ << "/log.txt for writing." << std::endl;
+            std::exit(1);
+        }
+    }
+    else {
+        std::cerr << "Unknown dataset format " << configs_.format << ", use jpeg or shards." << std::endl;
+        std::exit(1);
+    }
+
+    for (auto& slot : slots_) {
+        slot.state = FREE;
+        slot.ok = false;
+    }
+
+    for (int i = 0; i < configs_.threads; i++) {
+        threads_.emplace_back(&DatasetWriter::Run, this);
+    }
+}
+
+
+DatasetWriter::~DatasetWriter() {
+
+    Close();
+}
+
+
+bool DatasetWriter::Push(const DatasetRecord& record) {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!running_ || head_ - tail_ >= slots_.size()) {
+
+            uint64_t dropped = dropped_.fetch_add(1, std::memory_order_relaxed) + 1;
+
+            // Report drops, at most once a second.
+            double now = yarp::os::Time::now();
+
+            if (now - t_warned_ > 1.) {
+                std::cerr << "Dataset writer does not keep up, dropped " << dropped << " records so far." << std::endl;
+                t_warned_ = now;
+            }
+
+            return false;
+        }
+
+        Slot& slot = slots_[head_ % slots_.size()];
+
+        slot.record.epoch = record.epoch;
+        slot.record.time_stamp = record.time_stamp;
+        slot.record.left = record.left;
+        slot.record.disparity = record.disparity;
+        slot.record.vel.assign(record.vel.begin(), record.vel.end());
+        slot.record.crop = record.crop;
+        slot.state = QUEUED;
+
+        head_++;
+    }
+
+    cv_.notify_one();
+
+    return true;
+}
+
+
+void DatasetWriter::Close() {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+
+    cv_.notify_all();
+
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    // All records are encoded now.
+    WriteLog();
+
+    if (shard_writer_) {
+        shard_writer_->Close();
+    }
+
+    if (log_.is_open()) {
+        log_.close();
+    }
+}
+
+
+void DatasetWriter::Print(std::ostream& os) const {
+
+    os << "Dataset: " << GetWritten() << " records written, "
+       << GetDropped() << " dropped, " << GetFailed() << " failed." << std::endl;
+}
+
+
+void DatasetWriter::Run() {
+
+    SetRealtime(rt_configs_, "dataset_writer");
+
+    while (true) {
+
+        uint64_t i;
+
+        // Wait for a record, and drain the queue after stopping.
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return next_ < head_ || !running_; });
+
+            if (next_ == head_) {
+                break;
+            }
+
+            i = next_++;
+            slots_[i % slots_.size()].state = ENCODING;
+        }
+
+        // Slots, which are being encoded, are only touched by this thread.
+        Slot& slot = slots_[i % slots_.size()];
+
+        if (shards_) {
+            slot.ok = PackImages(slot);
+        }
+        else {
+
+            std::ostringstream ss;
+            ss << "_epoch_" << slot.record.epoch << "_" << std::setw(8) << std::setfill('0') << slot.record.time_stamp << ".jpg";
+
+            slot.ok = WriteImage(slot.record.left, slot.left_jpg, "data/img/left" + ss.str()) &&
+                      WriteImage(slot.record.disparity, slot.disparity_jpg, "data/img/wls_disp" + ss.str());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot.state = DONE;
+        }
+
+        WriteLog();
+    }
+}
+
+
+bool DatasetWriter::WriteImage(const cv::Mat& img, std::vector<unsigned char>& buf, const std::string& path) {
+
+    // The buffer keeps its capacity for the next record.
+    if (!cv::imencode(".jpg", img, buf, jpeg_params_)) {
+        return false;
+    }
+
+    std::ofstream file(out_location_ + "/" + path, std::ios_base::binary);
+    file.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+
+    return file.good();
+}
+
+
+bool DatasetWriter::PackImages(Slot& slot) {
+
+    const DatasetRecord& r = slot.record;
+
+    if (r.left.empty() || r.disparity.empty() || r.disparity.channels() != 1 || r.left.size() != r.disparity.size()) {
+        return false;
+    }
+
+    cv::Rect crop = r.crop.area() > 0 ? r.crop & cv::Rect(0, 0, r.left.cols, r.left.rows) : cv::Rect(0, 0, r.left.cols, r.left.rows);
+
+    // Resize copies the crop, so that the images can be views.
+    cv::resize(cv::Mat(r.left, crop), slot.left_small, configs_.shard_size, 0., 0., cv::INTER_AREA);
+    cv::resize(cv::Mat(r.disparity, crop), slot.disparity_small, configs_.shard_size, 0., 0., cv::INTER_AREA);
+
+    if (slot.left_small.channels() == 1) {
+        cv::cvtColor(slot.left_small, slot.left_small, cv::COLOR_GRAY2BGR);
+    }
+
+    // Interleave BGR and disparity.
+    const cv::Mat in[] = {slot.left_small, slot.disparity_small};
+    const int from_to[] = {0, 0, 1, 1, 2, 2, 3, 3};
+
+    slot.rgbd.create(configs_.shard_size, CV_8UC4);
+    cv::mixChannels(in, 2, &slot.rgbd, 1, from_to, 4);
+
+    return true;
+}
+
+
+void DatasetWriter::WriteLog() {
+
+    // One thread at a time appends to the log.
+    std::lock_guard<std::mutex> log_lock(log_mutex_);
+
+    while (true) {
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (tail_ == next_ || slots_[tail_ % slots_.size()].state != DONE) {
+                return;
+            }
+        }
+
+        // Slots, which are done, are only touched by the thread, which holds the log.
+        Slot& slot = slots_[tail_ % slots_.size()];
+        const DatasetRecord& r = slot.record;
+
+        if (slot.ok && shards_) {
+            slot.ok = shard_writer_->Append(slot.rgbd, r.vel, r.time_stamp, r.epoch);
+        }
+
+        if (slot.ok && shards_) {
+            written_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (slot.ok) {
+
+            std::ostringstream ss;
+            ss << "_epoch_" << r.epoch << "_" << std::setw(8) << std::setfill('0') << r.time_stamp << ".jpg";
+
+            log_ << "data/img/left" << ss.str() << ", " << "data/img/wls_disp" << ss.str();
+
+            for (const double& v : r.vel) {
+                log_ << ", " << v;
+            }
+            log_ << "\n";
+
+            written_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            std::cerr << "Could not write record " << r.time_stamp << " of epoch " << r.epoch << "." << std::endl;
+            failed_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Hand the slot back, without the references to the images.
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            slot.record.left.release();
+            slot.record.disparity.release();
+            slot.state = FREE;
+            tail_++;
+        }
+    }
+}
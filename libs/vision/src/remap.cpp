@@ -0,0 +1,81 @@
+#include "remap.h"
+
+// Fixed-point weights of the bilinear interpolation, which sum up to 1 << 2*INTER_BITS,
+// and the gray conversion of OpenCV, which sum up to 1 << GRAY_BITS.
+namespace {
+
+const int TAB_SIZE = 1 << cv::INTER_BITS;
+const int TAB_BITS = 2*cv::INTER_BITS;
+
+const int GRAY_BITS = 15;
+const int GRAY_B = 3735;
+const int GRAY_G = 19235;
+const int GRAY_R = 9798;
+
+} // namespace
+
+
+void RemapColorGray(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2,
+                    cv::Mat& rgb, cv::Mat& gray, int begin, int end) {
+
+    for (int y = begin; y < end; y++) {
+
+        const short* xy = map1.ptr<short>(y);
+        const unsigned short* a = map2.ptr<unsigned short>(y);
+        unsigned char* out = rgb.ptr<unsigned char>(y);
+        unsigned char* g = gray.ptr<unsigned char>(y);
+
+        for (int x = 0; x < map1.cols; x++) {
+
+            const int sx = xy[2*x];
+            const int sy = xy[2*x + 1];
+
+            int c0 = 0, c1 = 0, c2 = 0;
+
+            if (sx >= 0 && sy >= 0 && sx + 1 < src.cols && sy + 1 < src.rows) {
+
+                // Fractional part of the position, in units of 1/TAB_SIZE.
+                const int fx = a[x] & (TAB_SIZE - 1);
+                const int fy = a[x] >> cv::INTER_BITS;
+
+                const int w00 = (TAB_SIZE - fx)*(TAB_SIZE - fy);
+                const int w01 = fx*(TAB_SIZE - fy);
+                const int w10 = (TAB_SIZE - fx)*fy;
+                const int w11 = fx*fy;
+
+                const unsigned char* p0 = src.ptr<unsigned char>(sy) + 3*sx;
+                const unsigned char* p1 = src.ptr<unsigned char>(sy + 1) + 3*sx;
+
+                const int round = 1 << (TAB_BITS - 1);
+
+                c0 = (p0[0]*w00 + p0[3]*w01 + p1[0]*w10 + p1[3]*w11 + round) >> TAB_BITS;
+                c1 = (p0[1]*w00 + p0[4]*w01 + p1[1]*w10 + p1[4]*w11 + round) >> TAB_BITS;
+                c2 = (p0[2]*w00 + p0[5]*w01 + p1[2]*w10 + p1[5]*w11 + round) >> TAB_BITS;
+            }
+
+            out[3*x]     = c0;
+            out[3*x + 1] = c1;
+            out[3*x + 2] = c2;
+
+            // Same weights as cv::COLOR_BGR2GRAY.
+            g[x] = (c0*GRAY_B + c1*GRAY_G + c2*GRAY_R + (1 << (GRAY_BITS - 1))) >> GRAY_BITS;
+        }
+    }
+}
+
+
+cv::Mat TakeBuffer(std::vector<cv::Mat>& pool, const cv::Size& size, int type) {
+
+    for (auto& buffer : pool) {
+
+        // Only the pool references the buffer.
+        if (buffer.u != nullptr && CV_XADD(&buffer.u->refcount, 0) == 1 &&
+            buffer.size() == size && buffer.type() == type) {
+            return buffer;
+        }
+    }
+
+    pool.emplace_back(size, type);
+
+    return pool.back();
+}
@@ -0,0 +1,171 @@
+#include "shard.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+
+// Align an offset to 64 bytes.
+static uint64_t Align(uint64_t offset) {
+
+    return (offset + 63) & ~uint64_t(63);
+}
+
+
+// Implement ShardWriter.
+ShardWriter::ShardWriter(const std::string& dir, const cv::Size& size, int channels, int capacity)
+  : dir_(dir),
+    size_(size),
+    channels_(channels),
+    capacity_(capacity),
+    shards_(0),
+    records_(0) {
+
+    if (capacity_ < 1 || size_.area() == 0) {
+        std::cerr << "Shards need a capacity and an image size." << std::endl;
+        std::exit(1);
+    }
+
+    ::mkdir(dir_.c_str(), 0755);
+
+    std::memset(&header_, 0, sizeof(header_));
+}
+
+
+ShardWriter::~ShardWriter() {
+
+    Close();
+}
+
+
+bool ShardWriter::Append(const cv::Mat& rgbd, const std::vector<double>& vel, int64_t time, int32_t epoch) {
+
+    if (rgbd.size() != size_ || rgbd.channels() != channels_ || rgbd.depth() != CV_8U) {
+        std::cerr << "Record does not match the image size or channels of the shards." << std::endl;
+        return false;
+    }
+
+    if (file_.is_open() && vel.size() != header_.vel_dims) {
+        std::cerr << "Record does not match the velocity dimensions of the shards." << std::endl;
+        return false;
+    }
+
+    if (!file_.is_open() && !Open(vel.size())) {
+        return false;
+    }
+
+    const uint64_t i = header_.count;
+    const uint64_t bytes = uint64_t(size_.area())*channels_;
+
+    // Image, row by row, in case it is a view.
+    file_.seekp(header_.rgbd_offset + i*bytes);
+
+    for (int r = 0; r < rgbd.rows; r++) {
+        file_.write(reinterpret_cast<const char*>(rgbd.ptr(r)), rgbd.cols*channels_);
+    }
+
+    vel_.assign(vel.begin(), vel.end());
+
+    file_.seekp(header_.vel_offset + i*vel_.size()*sizeof(float));
+    file_.write(reinterpret_cast<const char*>(vel_.data()), vel_.size()*sizeof(float));
+
+    file_.seekp(header_.time_offset + i*sizeof(int64_t));
+    file_.write(reinterpret_cast<const char*>(&time), sizeof(int64_t));
+
+    file_.seekp(header_.epoch_offset + i*sizeof(int32_t));
+    file_.write(reinterpret_cast<const char*>(&epoch), sizeof(int32_t));
+
+    // Count the record, once it is complete.
+    header_.count++;
+
+    file_.seekp(offsetof(ShardHeader, count));
+    file_.write(reinterpret_cast<const char*>(&header_.count), sizeof(header_.count));
+
+    if (!file_.good()) {
+        std::cerr << "Could not write to " << name_ << "." << std::endl;
+        return false;
+    }
+
+    records_++;
+
+    if (header_.count == header_.capacity) {
+        Finish();
+    }
+
+    return true;
+}
+
+
+void ShardWriter::Close() {
+
+    if (file_.is_open()) {
+        Finish();
+    }
+}
+
+
+bool ShardWriter::Open(int vel_dims) {
+
+    // Continue after the shards of earlier recordings.
+    while (true) {
+
+        std::ostringstream ss;
+        ss << "shard_" << std::setw(5) << std::setfill('0') << shards_ << ".bin";
+        name_ = ss.str();
+
+        if (!std::ifstream(dir_ + "/" + name_).good()) {
+            break;
+        }
+
+        shards_++;
+    }
+
+    std::memset(&header_, 0, sizeof(header_));
+    std::memcpy(header_.magic, "BCSHARD1", 8);
+
+    header_.version = 1;
+    header_.width = size_.width;
+    header_.height = size_.height;
+    header_.channels = channels_;
+    header_.vel_dims = vel_dims;
+    header_.capacity = capacity_;
+    header_.count = 0;
+
+    header_.rgbd_offset  = SHARD_HEADER_SIZE;
+    header_.vel_offset   = Align(header_.rgbd_offset  + uint64_t(capacity_)*size_.area()*channels_);
+    header_.time_offset  = Align(header_.vel_offset   + uint64_t(capacity_)*vel_dims*sizeof(float));
+    header_.epoch_offset = Align(header_.time_offset  + uint64_t(capacity_)*sizeof(int64_t));
+
+    const uint64_t end = Align(header_.epoch_offset + uint64_t(capacity_)*sizeof(int32_t));
+
+    file_.open(dir_ + "/" + name_, std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+
+    if (!file_.is_open()) {
+        std::cerr << "Could not open " << dir_ << "/" << name_ << " for writing." << std::endl;
+        return false;
+    }
+
+    // Allocate the shard at full size, so that its arrays can be mapped right away.
+    char header[SHARD_HEADER_SIZE] = {};
+    std::memcpy(header, &header_, sizeof(header_));
+
+    file_.write(header, SHARD_HEADER_SIZE);
+    file_.seekp(end - 1);
+    file_.put(0);
+
+    return file_.good();
+}
+
+
+void ShardWriter::Finish() {
+
+    file_.close();
+
+    std::ofstream index(dir_ + "/index.txt", std::ios_base::app);
+    index << name_ << ", " << header_.count << "\n";
+
+    shards_++;
+}
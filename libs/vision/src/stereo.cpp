@@ -0,0 +1,295 @@
+#include "stereo.h"
+#include "remap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <yarp/os/all.h>
+
+StereoConfigs ReadStereoConfigs(const YAML::Node& configs) {
+
+    const YAML::Node node = configs["stereo"];
+
+    return {node["num_disparities"].as<int>(),
+            node["block_size"].as<int>(),
+            node["scale"].as<double>(),
+            node["lambda"].as<double>(),
+            node["sigma_color"].as<double>(),
+            node["period"].as<double>()};
+}
+
+
+// Implement StereoPipeline.
+StereoPipeline::StereoPipeline(const std::string& calib_file, bool rectify, const StereoConfigs& configs, const RealtimeConfigs& rt_configs)
+  : rectify_(rectify),
+    configs_(configs),
+    rt_configs_(rt_configs),
+    fused_(configs.scale >= MIN_FUSED_SCALE),
+    pipeline_(1),
+    latency_("stereo", configs.period),
+    t_start_(0.),
+    t_done_(0.),
+    pushed_(0),
+    done_(0) {
+
+    // Disparity range and block size at the scale of the matching. Block matching needs
+    // a multiple of 16 disparities, and an odd block size of at least 5.
+    if (configs_.scale <= 0. || configs_.scale > 1.) {
+        std::cerr << "Stereo scale has to be in (0, 1]." << std::endl;
+        std::exit(1);
+    }
+
+    int num_disparities = std::max(16, int(std::ceil(configs_.num_disparities*configs_.scale/16.))*16);
+    int block_size = std::max(5, int(std::round(configs_.block_size*configs_.scale)) | 1);
+
+    // Stereo matching and weighted least square filter.
+    l_matcher_ = cv::StereoBM::create(num_disparities, block_size);
+    r_matcher_ = cv::ximgproc::createRightMatcher(l_matcher_);
+    wls_ = cv::ximgproc::createDisparityWLSFilter(l_matcher_);
+
+    wls_->setLambda(configs_.lambda);
+    wls_->setSigmaColor(configs_.sigma_color);
+
+    // Calibration.
+    if (rectify_) {
+
+        cv::FileStorage fs(calib_file, cv::FileStorage::READ);
+
+        if (!fs.isOpened()) {
+            std::cerr << "Could not open the stereo calibration " << calib_file << "." << std::endl;
+            std::exit(1);
+        }
+
+        fs["K1"] >> K1_;
+        fs["K2"] >> K2_;
+        fs["D1"] >> D1_;
+        fs["D2"] >> D2_;
+        fs["R1"] >> R1_;
+        fs["R2"] >> R2_;
+        fs["P1"] >> P1_;
+        fs["P2"] >> P2_;
+    }
+
+    // The last stage is the filter, the other stages are run in Push.
+    auto rt = [this](const std::string& stage) {
+        return [this, stage]() { SetRealtime(rt_configs_, "stereo/" + stage); };
+    };
+
+    pipeline_.AddStage("match",  [this](Item& item) { return Match(item);  }, 0., true, rt("match"));
+    pipeline_.AddStage("filter", [this](Item& item) { return Filter(item); }, 0., true, rt("filter"));
+}
+
+
+StereoPipeline::~StereoPipeline() {
+
+    Stop();
+}
+
+
+void StereoPipeline::Start() {
+
+    t_start_ = yarp::os::Time::now();
+    pipeline_.Start();
+}
+
+
+void StereoPipeline::Stop() {
+
+    pipeline_.Stop();
+}
+
+
+bool StereoPipeline::Push(const cv::Mat& left, const cv::Mat& right, double time,
+                          const std::vector<double>& vel, int epoch, const std::function<bool()>& valid) {
+
+    if (left.size() != size_) {
+
+        size_ = left.size();
+        scaled_size_ = cv::Size(std::round(size_.width*configs_.scale), std::round(size_.height*configs_.scale));
+
+        // Rectification maps, which sample the images at the scale of the matching,
+        // or at full resolution, if the pairs are downsampled by area afterwards.
+        if (rectify_) {
+
+            const double scale = fused_ ? configs_.scale : 1.;
+
+            cv::Mat P1 = P1_.clone();
+            cv::Mat P2 = P2_.clone();
+
+            P1.rowRange(0, 2) *= scale;
+            P2.rowRange(0, 2) *= scale;
+
+            cv::initUndistortRectifyMap(K1_, D1_, R1_, P1, fused_ ? scaled_size_ : size_, CV_16SC2, lmap1_, lmap2_);
+            cv::initUndistortRectifyMap(K2_, D2_, R2_, P2, fused_ ? scaled_size_ : size_, CV_16SC2, rmap1_, rmap2_);
+        }
+    }
+
+    // The stages may still hold on to the buffers of earlier pairs.
+    item_.time = time;
+    item_.vel.assign(vel.begin(), vel.end());
+    item_.epoch = epoch;
+    item_.left.release();
+    item_.right.release();
+    item_.left_gray.release();
+    item_.right_gray.release();
+
+    if (rectify_ && fused_ && left.channels() == 3 && right.channels() == 3) {
+
+        // Take buffers, which are free again.
+        item_.left       = TakeBuffer(pool_, scaled_size_, CV_8UC3);
+        item_.right      = TakeBuffer(pool_, scaled_size_, CV_8UC3);
+        item_.left_gray  = TakeBuffer(pool_, scaled_size_, CV_8UC1);
+        item_.right_gray = TakeBuffer(pool_, scaled_size_, CV_8UC1);
+
+        // Rectify, downsample and convert to gray in one pass, the rows of both images in parallel.
+        const int rows = scaled_size_.height;
+
+        cv::parallel_for_(cv::Range(0, 2*rows), [&](const cv::Range& range) {
+
+            if (range.start < rows) {
+                RemapColorGray(left, lmap1_, lmap2_, item_.left, item_.left_gray, range.start, std::min(range.end, rows));
+            }
+            if (range.end > rows) {
+                RemapColorGray(right, rmap1_, rmap2_, item_.right, item_.right_gray, std::max(range.start, rows) - rows, range.end - rows);
+            }
+        });
+    }
+    else {
+
+        // Rectify the left and the right image in parallel, into new buffers.
+        cv::parallel_for_(cv::Range(0, 2), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; i++) {
+                if (i == 0) {
+                    Rectify(left, item_.left, item_.left_gray, lfull_, lmap1_, lmap2_);
+                }
+                else {
+                    Rectify(right, item_.right, item_.right_gray, rfull_, rmap1_, rmap2_);
+                }
+            }
+        });
+    }
+
+    // Drop the pair, if its input was overwritten in the meantime.
+    if (valid && !valid()) {
+        return false;
+    }
+
+    pushed_++;
+
+    return pipeline_.Push(item_);
+}
+
+
+bool StereoPipeline::Pop(StereoFrame& frame) {
+
+    return frames_.PopLatest(frame);
+}
+
+
+void StereoPipeline::Print(std::ostream& os) const {
+
+    double elapsed = t_done_ - t_start_;
+
+    os << "Stereo: " << pushed_ << " pairs, " << done_ << " disparities";
+    if (elapsed > 0.) {
+        os << ", " << done_/elapsed << " per second";
+    }
+    os << std::endl;
+
+    pipeline_.Print(os);
+    latency_.Print(os);
+}
+
+
+cv::Rect StereoPipeline::ScaleCrop(const cv::Rect& crop, const cv::Size& size) const {
+
+    double scale = configs_.scale;
+
+    int x0 = std::max(int(std::round(crop.x*scale)), GetNumDisparities() + GetBlockSize()/2);
+    int x1 = std::min(int(std::round((crop.x + crop.width)*scale)), size.width);
+    int y0 = std::round(crop.y*scale);
+    int y1 = std::min(int(std::round((crop.y + crop.height)*scale)), size.height);
+
+    return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+
+void StereoPipeline::Rectify(const cv::Mat& in, cv::Mat& out, cv::Mat& gray, cv::Mat& full, const cv::Mat& map1, const cv::Mat& map2) {
+
+    // Keep a copy, since the input may be a view into memory of others.
+    if (rectify_ && map1.size() == scaled_size_) {
+        cv::remap(in, out, map1, map2, cv::INTER_LINEAR);
+    }
+    else if (rectify_) {
+        // Rectify at full resolution, and downsample by area, which averages the pixels, as a pyramid would.
+        cv::remap(in, full, map1, map2, cv::INTER_LINEAR);
+        cv::resize(full, out, scaled_size_, 0., 0., cv::INTER_AREA);
+    }
+    else if (configs_.scale == 1.) {
+        in.copyTo(out);
+    }
+    else {
+        // Downsample by area, which averages the pixels, as a pyramid would.
+        cv::resize(in, out, scaled_size_, 0., 0., cv::INTER_AREA);
+    }
+
+    // Convert to gray image, unless the reader already did.
+    if (out.channels() == 3) {
+        cv::cvtColor(out, gray, cv::COLOR_BGR2GRAY);
+    }
+    else {
+        gray = out;
+    }
+}
+
+
+bool StereoPipeline::Match(Item& item) {
+
+    item.left_disp.release();
+    item.right_disp.release();
+
+    // Run the left and the right matcher concurrently.
+    cv::parallel_for_(cv::Range(0, 2), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            if (i == 0) {
+                l_matcher_->compute(item.left_gray, item.right_gray, item.left_disp);
+            }
+            else {
+                r_matcher_->compute(item.right_gray, item.left_gray, item.right_disp);
+            }
+        }
+    });
+
+    return true;
+}
+
+
+bool StereoPipeline::Filter(Item& item) {
+
+    item.disparity.release();
+
+    // Perform weighted least squares filtering.
+    wls_->filter(item.left_disp, item.left_gray, item.disparity, item.right_disp);
+
+    cv::ximgproc::getDisparityVis(item.disparity, item.disparity, 1);
+    cv::normalize(item.disparity, item.disparity, 0, 255, cv::NORM_MINMAX, CV_8U);
+
+    frame_.time = item.time;
+    frame_.left = item.left;
+    frame_.disparity = item.disparity;
+    frame_.vel.assign(item.vel.begin(), item.vel.end());
+    frame_.epoch = item.epoch;
+
+    // Replace the disparity, which was not taken yet.
+    frames_.Push(frame_);
+
+    // Latency from the time stamp of the pair to its disparity.
+    double now = yarp::os::Time::now();
+
+    latency_.Record(t_done_ > 0. ? now - t_done_ : configs_.period, now - item.time);
+    t_done_ = now;
+    done_++;
+
+    return true;
+}
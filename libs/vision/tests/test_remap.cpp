@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "remap.h"
+
+// The fixture for testing the rectification of RemapColorGray against cv::remap and cv::cvtColor.
+class RemapTest : public ::testing::Test   {
+    protected:
+
+    // Constructor.
+    RemapTest() {
+      // Random color image.
+      src_.create(48, 64, CV_8UC3);
+      cv::RNG rng(42);
+      rng.fill(src_, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+
+      // Camera with some distortion.
+      K_ = (cv::Mat_<double>(3, 3) << 60., 0., 32., 0., 60., 24., 0., 0., 1.);
+      D_ = (cv::Mat_<double>(1, 5) << -0.1, 0.02, 0.001, -0.001, 0.);
+    }
+
+    // Fixed-point maps, which sample an output of size at scale.
+    void Maps(double scale, cv::Size& size) {
+      size = cv::Size(std::round(src_.cols*scale), std::round(src_.rows*scale));
+
+      cv::Mat P = K_.clone();
+      P.rowRange(0, 2) *= scale;
+
+      cv::initUndistortRectifyMap(K_, D_, cv::Mat::eye(3, 3, CV_64F), P, size, CV_16SC2, map1_, map2_);
+    }
+
+    // Compare with cv::remap, where all four neighbours lie within the image.
+    void Compare(double scale) {
+      cv::Size size;
+      Maps(scale, size);
+
+      // Two ranges of rows, as the stereo pipeline runs them in parallel.
+      cv::Mat rgb(size, CV_8UC3), gray(size, CV_8UC1);
+      RemapColorGray(src_, map1_, map2_, rgb, gray, 0, size.height/2);
+      RemapColorGray(src_, map1_, map2_, rgb, gray, size.height/2, size.height);
+
+      cv::Mat ref_rgb, ref_gray, own_gray;
+      cv::remap(src_, ref_rgb, map1_, map2_, cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+      cv::cvtColor(ref_rgb, ref_gray, cv::COLOR_BGR2GRAY);
+      cv::cvtColor(rgb, own_gray, cv::COLOR_BGR2GRAY);
+
+      int inside = 0;
+
+      for (int y = 0; y < size.height; y++) {
+        for (int x = 0; x < size.width; x++) {
+          const cv::Vec2s& xy = map1_.at<cv::Vec2s>(y, x);
+
+          // The gray image is the conversion of the color one.
+          ASSERT_EQ(gray.at<uchar>(y, x), own_gray.at<uchar>(y, x)) << "at " << x << ", " << y;
+
+          if (xy[0] < 0 || xy[1] < 0 || xy[0] + 1 >= src_.cols || xy[1] + 1 >= src_.rows) {
+            EXPECT_EQ(rgb.at<cv::Vec3b>(y, x), cv::Vec3b(0, 0, 0)) << "at " << x << ", " << y;
+            continue;
+          }
+
+          inside++;
+
+          // Both round the fixed-point interpolation, but with different weights.
+          for (int c = 0; c < 3; c++) {
+            ASSERT_LE(std::abs(rgb.at<cv::Vec3b>(y, x)[c] - ref_rgb.at<cv::Vec3b>(y, x)[c]), 1) << "at " << x << ", " << y;
+          }
+          ASSERT_LE(std::abs(gray.at<uchar>(y, x) - ref_gray.at<uchar>(y, x)), 1) << "at " << x << ", " << y;
+        }
+      }
+
+      // Most of the image lies within.
+      EXPECT_GT(inside, size.area()/2);
+    }
+
+    // Member variables.
+    cv::Mat src_;
+    cv::Mat K_, D_;
+    cv::Mat map1_, map2_;
+};
+
+
+// Test the rectification at full resolution.
+TEST_F(RemapTest, FullScale) {
+    Compare(1.);
+}
+
+
+// Test the rectification, which downsamples in the same pass.
+TEST_F(RemapTest, HalfScale) {
+    Compare(0.5);
+}
+
+
+// Test the rectification at the scale of the navigation fast path. The stereo pipeline
+// downsamples by area at this scale, but the kernel has to match cv::remap all the same.
+TEST_F(RemapTest, NavigationScale) {
+    Compare(0.4);
+}
+
+
+// Test that the pool only hands out buffers, which nobody else references.
+TEST(TakeBufferTest, Reuse) {
+    std::vector<cv::Mat> pool;
+
+    cv::Mat a = TakeBuffer(pool, cv::Size(8, 4), CV_8UC1);
+    cv::Mat b = TakeBuffer(pool, cv::Size(8, 4), CV_8UC1);
+
+    EXPECT_EQ(pool.size(), 2);
+    EXPECT_NE(a.data, b.data);
+
+    // Once released, a buffer is handed out again.
+    uchar* data = a.data;
+    a.release();
+
+    cv::Mat c = TakeBuffer(pool, cv::Size(8, 4), CV_8UC1);
+
+    EXPECT_EQ(pool.size(), 2);
+    EXPECT_EQ(c.data, data);
+
+    // Buffers of another size or type are not.
+    cv::Mat d = TakeBuffer(pool, cv::Size(8, 4), CV_8UC3);
+
+    EXPECT_EQ(pool.size(), 3);
+    EXPECT_EQ(d.type(), CV_8UC3);
+}
@@ -0,0 +1,200 @@
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "dataset_writer.h"
+#include "shard.h"
+
+// Create an empty directory for a test.
+static std::string TempDir() {
+
+    char dir[] = "/tmp/vision_tests_XXXXXX";
+    return ::mkdtemp(dir);
+}
+
+
+// Read the header of a shard.
+static ShardHeader ReadHeader(const std::string& path) {
+
+    ShardHeader header;
+    std::memset(&header, 0, sizeof(header));
+
+    std::ifstream file(path, std::ios_base::binary);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    return header;
+}
+
+
+// Read an array of a shard at an offset.
+template<typename T>
+static std::vector<T> ReadArray(const std::string& path, uint64_t offset, size_t n) {
+
+    std::vector<T> array(n);
+
+    std::ifstream file(path, std::ios_base::binary);
+    file.seekg(offset);
+    file.read(reinterpret_cast<char*>(array.data()), n*sizeof(T));
+
+    return array;
+}
+
+
+// Test the layout of the shards, which are full or closed, and their index.
+TEST(ShardWriterTest, Layout) {
+    const std::string dir = TempDir();
+    const cv::Size size(4, 3);
+
+    ShardWriter writer(dir, size, 4, 2);
+
+    for (int i = 0; i < 3; i++) {
+        cv::Mat rgbd(size, CV_8UC4, cv::Scalar(i, i + 1, i + 2, i + 3));
+        ASSERT_TRUE(writer.Append(rgbd, {0.1*i, 0.2*i, 0.3*i}, 100*i, i/2));
+    }
+
+    writer.Close();
+
+    EXPECT_EQ(writer.GetShards(), 2);
+    EXPECT_EQ(writer.GetRecords(), 3);
+
+    // The first shard is full, the second one holds the last record.
+    for (int s = 0; s < 2; s++) {
+
+        const std::string path = dir + "/shard_0000" + std::to_string(s) + ".bin";
+        const ShardHeader header = ReadHeader(path);
+
+        EXPECT_EQ(std::string(header.magic, 8), "BCSHARD1");
+        EXPECT_EQ(header.width, 4);
+        EXPECT_EQ(header.height, 3);
+        EXPECT_EQ(header.channels, 4);
+        EXPECT_EQ(header.vel_dims, 3);
+        EXPECT_EQ(header.capacity, 2);
+        EXPECT_EQ(header.count, s == 0 ? 2 : 1);
+
+        EXPECT_EQ(header.rgbd_offset, SHARD_HEADER_SIZE);
+        EXPECT_EQ(header.vel_offset % 64, 0);
+        EXPECT_EQ(header.time_offset % 64, 0);
+        EXPECT_EQ(header.epoch_offset % 64, 0);
+
+        const std::vector<uint8_t> rgbd = ReadArray<uint8_t>(path, header.rgbd_offset, header.count*size.area()*4);
+        const std::vector<float> vel = ReadArray<float>(path, header.vel_offset, header.count*3);
+        const std::vector<int64_t> time = ReadArray<int64_t>(path, header.time_offset, header.count);
+        const std::vector<int32_t> epoch = ReadArray<int32_t>(path, header.epoch_offset, header.count);
+
+        for (uint64_t r = 0; r < header.count; r++) {
+
+            const int i = 2*s + r;
+
+            EXPECT_EQ(rgbd[r*size.area()*4], i);
+            EXPECT_EQ(rgbd[(r + 1)*size.area()*4 - 1], i + 3);
+            EXPECT_FLOAT_EQ(vel[3*r + 2], 0.3*i);
+            EXPECT_EQ(time[r], 100*i);
+            EXPECT_EQ(epoch[r], i/2);
+        }
+    }
+
+    // Both shards are listed with their count.
+    std::ifstream index(dir + "/index.txt");
+    std::string line;
+
+    ASSERT_TRUE(std::getline(index, line));
+    EXPECT_EQ(line, "shard_00000.bin, 2");
+    ASSERT_TRUE(std::getline(index, line));
+    EXPECT_EQ(line, "shard_00001.bin, 1");
+}
+
+
+// Test that records, which do not match the shards, are rejected.
+TEST(ShardWriterTest, Mismatch) {
+    const std::string dir = TempDir();
+
+    ShardWriter writer(dir, cv::Size(4, 3), 4, 2);
+
+    EXPECT_FALSE(writer.Append(cv::Mat(3, 5, CV_8UC4), {0., 0.}, 0, 0));
+    EXPECT_FALSE(writer.Append(cv::Mat(3, 4, CV_8UC3), {0., 0.}, 0, 0));
+    EXPECT_TRUE(writer.Append(cv::Mat(3, 4, CV_8UC4, cv::Scalar::all(0)), {0., 0.}, 0, 0));
+    EXPECT_FALSE(writer.Append(cv::Mat(3, 4, CV_8UC4, cv::Scalar::all(0)), {0., 0., 0.}, 0, 0));
+
+    EXPECT_EQ(writer.GetRecords(), 1);
+}
+
+
+// The fixture for testing the shards of the dataset writer, which only keep the crop of the images.
+class DatasetWriterTest : public ::testing::Test   {
+    protected:
+
+    // Constructor.
+    DatasetWriterTest() {
+      dir_ = TempDir();
+      ::mkdir((dir_ + "/data").c_str(), 0755);
+
+      // Images, which only hold the colors of the record within the crop.
+      record_.epoch = 3;
+      record_.time_stamp = 7;
+      record_.left = cv::Mat(30, 40, CV_8UC3, cv::Scalar(200, 200, 200));
+      record_.disparity = cv::Mat(30, 40, CV_8UC1, cv::Scalar(250));
+      record_.vel = {0.1, 0., -0.2};
+      record_.crop = cv::Rect(10, 5, 16, 12);
+
+      record_.left(record_.crop).setTo(cv::Scalar(10, 20, 30));
+      record_.disparity(record_.crop).setTo(cv::Scalar(40));
+
+      // Shards at half the size of the crop.
+      DatasetWriterConfigs configs{4, 2, 90, "shards", cv::Rect(), cv::Size(8, 6), 16};
+
+      DatasetWriter writer(dir_, configs);
+      EXPECT_TRUE(writer.Push(record_));
+      writer.Close();
+
+      EXPECT_EQ(writer.GetWritten(), 1);
+    }
+
+    // Member variables.
+    std::string dir_;
+    DatasetRecord record_;
+};
+
+
+// Test that the shard keeps the crop of the record.
+TEST_F(DatasetWriterTest, ShardCrop) {
+    const std::string path = dir_ + "/data/shards/shard_00000.bin";
+    const ShardHeader header = ReadHeader(path);
+
+    ASSERT_EQ(header.count, 1);
+    ASSERT_EQ(header.width, 8);
+    ASSERT_EQ(header.height, 6);
+
+    const std::vector<uint8_t> rgbd = ReadArray<uint8_t>(path, header.rgbd_offset, 8*6*4);
+
+    for (int i = 0; i < 8*6; i++) {
+        ASSERT_EQ(rgbd[4*i],     10) << "pixel " << i;
+        ASSERT_EQ(rgbd[4*i + 1], 20) << "pixel " << i;
+        ASSERT_EQ(rgbd[4*i + 2], 30) << "pixel " << i;
+        ASSERT_EQ(rgbd[4*i + 3], 40) << "pixel " << i;
+    }
+}
+
+
+// Test that open_shard of libs/learning/python/shards.py reads the shard, which was
+// written here, with the crop of the record. Skipped, if shards.py can not be imported.
+TEST_F(DatasetWriterTest, PythonRoundTrip) {
+    const std::string python = std::string("python3 -c \"import sys; sys.path.insert(0, '") + SHARDS_PY_DIR + "'); ";
+
+    if (std::system((python + "import shards\"").c_str()) != 0) {
+        GTEST_SKIP() << "Could not import shards.py.";
+    }
+
+    const std::string check = python + "import shards; "
+        "s = shards.open_shard('" + dir_ + "/data/shards/shard_00000.bin'); "
+        "assert s['rgbd'].shape == (1, 6, 8, 4), s['rgbd'].shape; "
+        "assert (s['rgbd'] == [10, 20, 30, 40]).all(), 'crop'; "
+        "assert abs(s['vel'][0][0] - 0.1) < 1e-6 and abs(s['vel'][0][2] + 0.2) < 1e-6, 'vel'; "
+        "assert s['time'][0] == 7 and s['epoch'][0] == 3, 'time and epoch'\"";
+
+    EXPECT_EQ(std::system(check.c_str()), 0);
+}
@@ -0,0 +1,13 @@
+# Loopback robot shell script.
+
+# Location of shell script.
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" >/dev/null && pwd )"
+
+# The loopback robot serves the ports of the robot without hardware or
+# simulator, so the whole pipeline can be benchmarked on one machine. It
+# needs a name server, e.g. yarpserver --write, and user controlled walking
+# is then run with --robot loopback --simulation true.
+robot="loopback"
+
+cd $DIR/../build/bin
+./loopback_robot --io_config ../../libs/io_module/configs.yaml --robot $robot
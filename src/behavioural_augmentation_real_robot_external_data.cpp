@@ -7,7 +7,11 @@
 #include <rbdl/rbdl.h>
 #include <qpOASES.hpp>
 
+#include "async_csv_writer.h"
 #include "reader.h"
+#include "realtime.h"
+#include "stereo.h"
+#include "tick_statistics.h"
 #include "writer.h"
 #include "nmpc_generator.h"
 #include "mpc_generator.h"
@@ -30,6 +34,11 @@ std::string out_loc;
 // Forward declare output location.
 std::string net_loc;
 
+// Crop of the full resolution images, which removes the sky, as well as the
+// border, where the disparity has no values, and the input size of the network.
+const cv::Rect crop(38, 6, 276, 185);
+const cv::Size net_input(80/*width*/, 60/*height*/);
+
 // Forward declare BehaviouralAugmentation. This is actually the heart
 // of the application. Within it, the pattern is generated,
 // and the  inverse kinematics is computed. Also, images and velocities
@@ -112,9 +121,27 @@ class GenerateVelocityCommands : public yarp::os::RateThread
         ~GenerateVelocityCommands();
 
     private:
+        bool threadInit() override;
         void run() override;
+        void threadRelease() override;
         void ProcessImages();
-        cv::Mat Crop(cv::Mat& img);
+        cv::Mat Crop(const cv::Mat& img);
+
+        // Stereo configurations. With the fast path, pairs are matched at the
+        // scale, which leaves the crop just above the network input.
+        static StereoConfigs ReadConfigs();
+
+        // Device of the inference, cpu or cuda.
+        static torch::Device ReadDevice();
+
+        // Write the left image and the disparity at the input size of the network,
+        // normalized, into the ring as the newest frame of the sequence. With the
+        // split inference, the frame is encoded, and its embedding is written instead.
+        void PushFrame();
+
+        // Run the network, or the temporal head, on the sequence in the ring, and
+        // return its output on the cpu.
+        torch::Tensor Forward();
 
         // Ports to read velocities, images, and the current epoch.
         yarp::os::BufferedPort<yarp::sig::Vector> port_vel_;        
@@ -129,29 +156,43 @@ class GenerateVelocityCommands : public yarp::os::RateThread
         // Parts.
         std::vector<Part> parts_;
 
-        // Script module to perform actions.
+        // Script module to perform actions, on the device of the inference. With the
+        // split inference, a per-frame encoder and a temporal head take its place.
         std::shared_ptr<torch::jit::script::Module> module_;
-
-        // Que that holds images for lstm.
-        std::vector<torch::Tensor> que_;
-        
-        torch::Tensor rgbd_;
+        std::shared_ptr<torch::jit::script::Module> encoder_;
+        std::shared_ptr<torch::jit::script::Module> head_module_;
+        bool split_;
+        torch::Device device_;
+        int threads_;
+        int warmup_;
+
+        // Latency of the inference.
+        TickStatistics inference_;
+        std::unique_ptr<AsyncCsvWriter> inference_log_;
+        Eigen::Vector2d inference_row_;
+        double t_inference_;
+
+        // Ring that holds the sequence of images for the lstm, on the device of the inference.
+        // Each frame is written twice, sequence_length_ apart, so that the sequence, from the
+        // oldest to the newest frame, is always the contiguous view of the ring from head_ on.
+        // With the split inference, the ring holds the embeddings, and frame_in_ the newest image.
+        int sequence_length_;
+        torch::Tensor frame_in_;
+        torch::Tensor ring_;
+        int head_;
         torch::Tensor t_vel_;
         yarp::sig::Vector vel_;
 
-        // Images of the cameras.
+        // Images of the cameras, views into the memory of the ports.
         std::map<std::string, yarp::sig::ImageOf<yarp::sig::PixelRgb>> imgs_;
         std::map<std::string, cv::Mat> imgs_cv_rgb_;
-        std::map<std::string, cv::Mat> imgs_cv_gra_;
 
-        // Stereo matching and weighted least square filter.
-        cv::Ptr<cv::StereoBM> l_matcher_;
-        cv::Ptr<cv::StereoMatcher> r_matcher_;
-        cv::Ptr<cv::ximgproc::DisparityWLSFilter> wls_;
+        // Rectification, stereo matching and weighted least square filter, and the latest disparity.
+        StereoPipeline stereo_;
+        StereoFrame frame_;
 
-        // Disparity map.
-        cv::Mat l_disp_; 
-        cv::Mat r_disp_; 
+        // Left image and disparity at the input size of the network.
+        cv::Mat rgb_;
         cv::Mat wls_disp_;
 
         // Position initialized.
@@ -160,17 +201,6 @@ class GenerateVelocityCommands : public yarp::os::RateThread
 
         // Port to communicate the status.
         yarp::os::BufferedPort<yarp::os::Bottle> port_status_;
-
-        // Calibration.
-        bool calib_initialized_;
-        bool wls_initialized_;
-
-        cv::Mat R1_, R2_, P1_, P2_, Q_;
-        cv::Mat K1_, K2_, R_;
-        cv::Vec3d T_;
-        cv::Mat D1_, D2_;
-
-        cv::Mat lmapx_, lmapy_, rmapx_, rmapy_;
 };
 
 ///////////////// NEW
@@ -571,10 +601,25 @@ GenerateVelocityCommands::GenerateVelocityCommands(int period, std::vector<Part>
 	  time_stamp_(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time_)),
       parts_(parts),
 
-      // Que that holds images for lstm.
-      que_(5/*sequence_length*/, torch::zeros({1, 1, 4, 60, 80})),
+      // Inference.
+      split_(YAML::LoadFile(io_config)["navigation_inference"]["split"].as<bool>()),
+      device_(ReadDevice()),
+      threads_(YAML::LoadFile(io_config)["navigation_inference"]["threads"].as<int>()),
+      warmup_(YAML::LoadFile(io_config)["navigation_inference"]["warmup"].as<int>()),
+      inference_("inference", period*1e-3, 1e-3, 500),
+      inference_log_(new AsyncCsvWriter("inference_latency.csv", 2)),
+      t_inference_(0.),
+
+      // Ring that holds images for lstm.
+      sequence_length_(5),
+      frame_in_(torch::zeros({1, 4, net_input.height, net_input.width}, torch::TensorOptions().device(device_))),
+      ring_(torch::zeros({1, 2*sequence_length_, 4, net_input.height, net_input.width}, torch::TensorOptions().device(device_))),
+      head_(0),
       vel_(3),
 
+      // Stereo.
+      stereo_(calib_file, true, ReadConfigs(), ReadRealtimeConfigs(YAML::LoadFile(io_config), "stereo")),
+
       // Position initialized.
       robot_status_(NOT_INITIALIZED),
       initialized_(false)
@@ -591,34 +636,155 @@ GenerateVelocityCommands::GenerateVelocityCommands(int period, std::vector<Part>
         }
     }
 
-    // Script module to perform actions.
-    module_ = torch::jit::load(net_location);
+    // Script module to perform actions, loaded onto the device of the inference.
+    if (!split_) {
+        module_ = torch::jit::load(net_location, device_);
+    }
+    else {
 
-    // Stereo matching and weighted least square filter.
-    l_matcher_ = cv::StereoBM::create(32, 13);
-    r_matcher_ = cv::ximgproc::createRightMatcher(l_matcher_);
-    wls_ = cv::ximgproc::createDisparityWLSFilter(l_matcher_);
+        // Encoder and head, as exported next to the network by python_to_cpp.py.
+        std::string stem = net_location.substr(0, net_location.rfind(".pt"));
 
-    wls_->setLambda(1.e4);
-    wls_->setSigmaColor(1.);
+        encoder_ = torch::jit::load(stem + "_encoder.pt", device_);
+        head_module_ = torch::jit::load(stem + "_head.pt", device_);
 
-    // Calibration.
-    calib_initialized_ = false;
-    wls_initialized_ = false;
+        // Embeddings of the empty frames, which the whole network would see at the start.
+        torch::NoGradGuard no_grad;
 
-    cv::FileStorage fs1(calib_file, cv::FileStorage::READ);
-    fs1["K1"] >> K1_;
-    fs1["K2"] >> K2_;
-    fs1["D1"] >> D1_;
-    fs1["D2"] >> D2_;
-    fs1["R"] >> R_;
-    fs1["T"] >> T_;
+        std::vector<torch::jit::IValue> input;
+        input.push_back(frame_in_);
+
+        torch::Tensor embedding = encoder_->forward(input).toTensor();
+
+        ring_ = torch::zeros({1, 2*sequence_length_, embedding.size(1)}, torch::TensorOptions().device(device_));
+        ring_.copy_(embedding.unsqueeze(1));
+    }
+
+    std::cout << "Matching stereo pairs at a scale of " << stereo_.GetScale() << ", with " << stereo_.GetNumDisparities()
+              << " disparities and a block size of " << stereo_.GetBlockSize() << "." << std::endl;
+}
+
+
+StereoConfigs GenerateVelocityCommands::ReadConfigs() {
+
+    YAML::Node configs = YAML::LoadFile(io_config);
+    StereoConfigs stereo = ReadStereoConfigs(configs);
+
+    double margin = configs["navigation_fast_path"].as<double>();
+
+    if (margin > 0.) {
+        stereo.scale = std::min(1., margin*std::max(double(net_input.width)/crop.width, double(net_input.height)/crop.height));
+    }
 
-    fs1["R1"] >> R1_;
-    fs1["R2"] >> R2_;
-    fs1["P1"] >> P1_;
-    fs1["P2"] >> P2_;
-    fs1["Q"] >> Q_;
+    return stereo;
+}
+
+
+torch::Device GenerateVelocityCommands::ReadDevice() {
+
+    std::string device = YAML::LoadFile(io_config)["navigation_inference"]["device"].as<std::string>();
+
+    if (device != "cpu" && device != "cuda") {
+        std::cerr << "Unknown inference device " << device << ", use cpu or cuda." << std::endl;
+        std::exit(1);
+    }
+
+    if (device == "cuda" && !torch::cuda::is_available()) {
+        std::cerr << "Inference on cuda was requested, but cuda is not available." << std::endl;
+        std::exit(1);
+    }
+
+    return device == "cuda" ? torch::Device(torch::kCUDA) : torch::Device(torch::kCPU);
+}
+
+
+bool GenerateVelocityCommands::threadInit() {
+
+    // Keep the stereo processing away from the cores of the control threads.
+    SetRealtime(ReadRealtimeConfigs(YAML::LoadFile(io_config), "stereo"), "stereo");
+
+    // Intra-op threads of the inference, which runs on this thread.
+    if (threads_ > 0) {
+        torch::set_num_threads(threads_);
+    }
+
+    // Warm up the network on the empty ring, so that the first command is not late.
+    double t0 = yarp::os::Time::now();
+
+    for (int i = 0; i < warmup_; i++) {
+
+        if (split_) {
+            torch::NoGradGuard no_grad;
+
+            std::vector<torch::jit::IValue> input;
+            input.push_back(frame_in_);
+
+            encoder_->forward(input);
+        }
+
+        Forward();
+    }
+
+    std::cout << "Inference on " << (device_.is_cuda() ? "cuda" : "cpu") << " with " << torch::get_num_threads()
+              << " threads, warmed up in " << (yarp::os::Time::now() - t0)*1e3 << " ms." << std::endl;
+
+    stereo_.Start();
+
+    return true;
+}
+
+
+void GenerateVelocityCommands::threadRelease() {
+
+    stereo_.Stop();
+    stereo_.Print();
+
+    inference_.Print();
+    inference_log_->Close();
+}
+
+
+void GenerateVelocityCommands::PushFrame() {
+
+    torch::NoGradGuard no_grad;
+
+    // Views of the images, hxwxc -> cxhxw, without copies.
+    torch::Tensor rgb = torch::from_blob(rgb_.data, {rgb_.rows, rgb_.cols, 3}, torch::kByte).permute({2, 0, 1});
+    torch::Tensor d = torch::from_blob(wls_disp_.data, {1, wls_disp_.rows, wls_disp_.cols}, torch::kByte);
+
+    // Convert to float, copy to the device and normalize, in place.
+    torch::Tensor frame = split_ ? frame_in_.select(0, 0) : ring_.select(1, head_).select(0, 0);
+
+    frame.narrow(0, 0, 3).copy_(rgb);
+    frame.narrow(0, 3, 1).copy_(d);
+    frame.div_(127.5).sub_(1.);
+
+    // Encode the newest frame only, the others were encoded on earlier steps.
+    if (split_) {
+
+        std::vector<torch::jit::IValue> input;
+        input.push_back(frame_in_);
+
+        ring_.select(1, head_).copy_(encoder_->forward(input).toTensor());
+    }
+
+    ring_.select(1, head_ + sequence_length_).copy_(ring_.select(1, head_));
+
+    head_ = (head_ + 1) % sequence_length_;
+}
+
+
+torch::Tensor GenerateVelocityCommands::Forward() {
+
+    // No gradients are needed, which spares their bookkeeping.
+    torch::NoGradGuard no_grad;
+
+    // The sequence is a view into the ring, on the device already.
+    std::vector<torch::jit::IValue> input;
+    input.push_back(ring_.narrow(1, head_, sequence_length_));
+
+    // Copying the output to the cpu waits for the device.
+    return (split_ ? head_module_ : module_)->forward(input).toTensor().cpu();
 }
 
 
@@ -631,38 +797,30 @@ void GenerateVelocityCommands::run() {
         robot_status_ = RobotStatus(bottle->pop().asDict()->find("RobotStatus").asInt());
     }
 
-    // Read current images, compute depth image.
+    // Read current images, and hand them to the depth computation.
     ProcessImages();
 
-    if (calib_initialized_ && wls_initialized_) {
-        
-        // Convert them to tensor.  SIZES NEEDS TO BE CHANGES HERE
-        torch::Tensor rgb = torch::from_blob(imgs_cv_rgb_["left"].data, {1, 1, imgs_cv_rgb_["left"].rows, imgs_cv_rgb_["left"].cols, 3}, torch::kByte); // different order cv hxwxc -> torch cxhxw
-        torch::Tensor d = torch::from_blob(wls_disp_.data, {1, 1, wls_disp_.rows, wls_disp_.cols, 1}, torch::kByte);
+    if (stereo_.Pop(frame_)) {
 
-        rgb = rgb.to(torch::kF32); // of course convert to float
-        d = d.to(torch::kF32);
+        // Crop and resize the left image and the disparity map.
+        cv::resize(Crop(frame_.left), rgb_, net_input);
+        cv::resize(Crop(frame_.disparity), wls_disp_, net_input);
+        
+        // Predict action, and log the latency of the inference.
+        double start = yarp::os::Time::now();
 
-        // Concatenate and normalize images. PERMUTE TO BE CHANGED FOR ADDITIONAL DIMENSION
-        rgb = rgb.permute({0, 1, 4, 2, 3}); // hxwxc -> cxhxw
-        d = d.permute({0, 1, 4, 2, 3});
+        // Write them into the sequence, without allocations, and run the network.
+        PushFrame();
 
-        rgb = rgb.div(127.5).sub(1.); // normalize on tensors
-        d = d.div(127.5).sub(1.);
+        t_vel_ = Forward();
 
-        // Fill que.
-        for (int j = 0; j < que_.size() - 1; j++) {
-            que_[j] = que_[j+1];
-        }
-        que_[que_.size() - 1] = torch::cat({rgb, d}, 2/*dim*/); // CONCATENATION CHANGED FOR ADDITIONAL DIMENSION
+        double stop = yarp::os::Time::now();
 
-        // Predict action
-        std::vector<torch::jit::IValue> input;
-        torch::Tensor rgbd = torch::cat(que_, 1 /*dim*/).cuda(); // ADD TIME DIMENSION HERE
-        input.push_back(rgbd);
+        inference_.Record(t_inference_ > 0. ? start - t_inference_ : getRate()*1e-3, stop - start);
+        t_inference_ = start;
 
-        // Execute the model and turn its output into a tensor.
-        t_vel_ = module_->forward(input).toTensor().cpu();
+        inference_row_ << start, stop - start;
+        inference_log_->Push(inference_row_);
 
         // // Write velocity command to port.
         vel_(0) = double(*(t_vel_.data<float>()))*0.15;
@@ -684,7 +842,7 @@ void GenerateVelocityCommands::run() {
         std::ofstream txt(out_location_ + "/behavioural_augmentation_measurements/log.txt", std::ios_base::app);
 
         std::string loc = out_location_ + "/behavioural_augmentation_measurements/img/left_" + ss.str() + ".jpg";
-        cv::imwrite(loc, imgs_cv_rgb_["left"]);
+        cv::imwrite(loc, rgb_);
         txt << "behavioural_augmentation_measurements/img/left_" + ss.str() + ".jpg" + ", ";
 
 
@@ -732,70 +890,22 @@ void GenerateVelocityCommands::ProcessImages() {
                 // Convert the images to a format that OpenCV uses.
                 imgs_cv_rgb_[camera] = cv::cvarrToMat(img->getIplImage());
 
-                if (calib_initialized_) {
-
-                    if (camera == "left") {
-
-                        cv::remap(imgs_cv_rgb_[camera], imgs_cv_rgb_[camera], lmapx_, lmapy_, cv::INTER_LINEAR);
-                    }
-                    else {
-
-                        cv::remap(imgs_cv_rgb_[camera], imgs_cv_rgb_[camera], rmapx_, rmapy_, cv::INTER_LINEAR);
-                    }
-                }
-
-                // Convert to gray image.
-                cv::cvtColor(imgs_cv_rgb_[camera], imgs_cv_gra_[camera], cv::COLOR_BGR2GRAY);
-
                 null = false;
             }
         }
     }
-    if (!null) {
-        if (calib_initialized_) {
-            
-            // Determine disparity.
-            l_matcher_->compute(imgs_cv_gra_[parts_[0].cameras[0]], imgs_cv_gra_[parts_[0].cameras[1]], l_disp_);
-
-            r_matcher_->compute(imgs_cv_gra_[parts_[0].cameras[1]], imgs_cv_gra_[parts_[0].cameras[0]], r_disp_);
-
-            // Perform weighted least squares filtering.
-            wls_->filter(l_disp_, imgs_cv_gra_[parts_[0].cameras[0]], wls_disp_, r_disp_);
-
-            cv::ximgproc::getDisparityVis(wls_disp_, wls_disp_, 1);
-            cv::normalize(wls_disp_, wls_disp_, 0, 255, CV_MINMAX, CV_8U);
-
-            // Crop and resize images.
-            for (const auto& part : parts_) {
-                for (const auto& camera : part.cameras) {
 
-                    imgs_cv_rgb_[camera] = Crop(imgs_cv_rgb_[camera]);
-                    cv::resize(imgs_cv_rgb_[camera], imgs_cv_rgb_[camera], cv::Size(80, 60));
-                }
-            }
-
-            // Crop and resize the disparity map.
-            l_disp_ = Crop(l_disp_);
-            wls_disp_ = Crop(wls_disp_);
-
-            cv::resize(l_disp_, l_disp_, cv::Size(80/*width*/, 60/*height*/));
-            cv::resize(wls_disp_, wls_disp_, cv::Size(80, 60));
-            wls_initialized_ = true;
-        }
-        else {
-
-            cv::initUndistortRectifyMap(K1_, D1_, R1_, P1_, imgs_cv_rgb_["left"].size(), CV_32F, lmapx_, lmapy_);
-            cv::initUndistortRectifyMap(K2_, D2_, R2_, P2_, imgs_cv_rgb_["right"].size(), CV_32F, rmapx_, rmapy_);
+    // Hand the pair over to the stereo pipeline.
+    if (!null && imgs_cv_rgb_.size() == 2) {
 
-            calib_initialized_ = true;
-        }
+        stereo_.Push(imgs_cv_rgb_[parts_[0].cameras[0]], imgs_cv_rgb_[parts_[0].cameras[1]], yarp::os::Time::now());
     }
 }
 
-cv::Mat GenerateVelocityCommands::Crop(cv::Mat& img) {
+cv::Mat GenerateVelocityCommands::Crop(const cv::Mat& img) {
 
     // The sizes are a little hacky right now.
     // It crops the sky, as well as borders where the wls disparity map
     // has no values.
-    return cv::Mat(img, cv::Rect(38, 6, 276, 185)).clone(); // rect is only a rapper on the memory, need to clone
+    return cv::Mat(img, stereo_.ScaleCrop(crop, img.size())); // rect is only a rapper on the memory, resize copies it
 }
@@ -7,6 +7,9 @@
 #include <qpOASES.hpp>
 
 #include "reader.h"
+#include "dataset_writer.h"
+#include "realtime.h"
+#include "stereo.h"
 #include "writer.h"
 #include "nmpc_generator.h"
 #include "mpc_generator.h"
@@ -26,6 +29,9 @@ std::string robot;
 // Forward declare simulation.
 bool simulation;
 
+// Forward declare replay of recorded traffic.
+bool replay;
+
 // Forward declare output location.
 std::string out_loc;
 
@@ -109,9 +115,14 @@ class StoreData : public yarp::os::RateThread
         inline const int& GetEpoch() const { return epoch_; };
 
     private:
+        bool threadInit() override;
+        void threadRelease() override;
         void run() override;
         void ProcessImages();
 
+        // Read the latest stereo pair from shared memory.
+        bool ReadSharedImages();
+
         // Ports to read velocities, images, and the current epoch.
         yarp::os::BufferedPort<yarp::sig::Vector> port_vel_;        
         std::map<std::string, yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb>>> ports_img_;
@@ -124,26 +135,33 @@ class StoreData : public yarp::os::RateThread
         std::chrono::milliseconds time_stamp_;
         int epoch_;
 
-        // Current velocity.
+        // Current velocity, and its copy, which labels a pair of images.
         Eigen::Vector3d vel_;
+        std::vector<double> vel_sample_;
 
         // Parts.
         std::vector<Part> parts_;
 
-        // Images of the cameras.
+        // Images of the cameras, views into the memory of the ports or shared memory.
         std::map<std::string, yarp::sig::ImageOf<yarp::sig::PixelRgb>> imgs_;
         std::map<std::string, cv::Mat> imgs_cv_rgb_;
-        std::map<std::string, cv::Mat> imgs_cv_gra_;
+        double imgs_time_;
 
-        // Stereo matching and weighted least square filter.
-        cv::Ptr<cv::StereoBM> l_matcher_;
-        cv::Ptr<cv::StereoMatcher> r_matcher_;
-        cv::Ptr<cv::ximgproc::DisparityWLSFilter> wls_;
+        // Shared memory of the camera reader on this host. Left and right frames
+        // are paired, if their time stamps differ less than pair_tol_ seconds.
+        bool shared_images_;
+        double pair_tol_;
+        std::map<std::string, std::unique_ptr<SharedImageRing>> rings_;
+        std::map<std::string, SharedFrame> frames_;
+        uint64_t last_written_;
 
-        // Disparity map.
-        cv::Mat l_disp_; 
-        cv::Mat r_disp_; 
-        cv::Mat wls_disp_;
+        // Rectification, stereo matching and weighted least square filter, and the latest disparity.
+        StereoPipeline stereo_;
+        StereoFrame frame_;
+
+        // Writes the images and the log off the camera thread.
+        DatasetWriter writer_;
+        DatasetRecord record_;
 
         // Position initialized.
         RobotStatus robot_status_;
@@ -151,17 +169,6 @@ class StoreData : public yarp::os::RateThread
 
         // Port to communicate the status.
         yarp::os::BufferedPort<yarp::os::Bottle> port_status_;
-
-        // Calibration.
-        bool simulation_;
-        bool calib_initialized_;
-
-        cv::Mat R1_, R2_, P1_, P2_, Q_;
-        cv::Mat K1_, K2_, R_;
-        cv::Vec3d T_;
-        cv::Mat D1_, D2_;
-
-        cv::Mat lmapx_, lmapy_, rmapx_, rmapy_;
 };
 
 
@@ -229,7 +236,12 @@ int main(int argc, char *argv[]) {
         std::cerr << "Please specify whether or not to run in simulation" << std::endl;
         std::cerr << "--simulation (e.g. true)" << std::endl;
         std::exit(1);
-    }   
+    }
+
+    // Replay of recorded traffic, see replay_traffic. The reader and the writer
+    // still run against --robot, for the joint limits and the commands, so a
+    // replay needs a robot, usually the loopback robot.
+    replay = params.check("replay") && params.find("replay").asBool();   
 
     // Set up the yarp network.
     yarp::os::Network yarp;
@@ -251,6 +263,11 @@ int main(int argc, char *argv[]) {
     BehaviouralCloning bc_port(min, max, simulation); 
     bc_port.open("/behavioural_cloning/nmpc_pattern_generator");
 
+    // Queue all replayed joint states, instead of only the latest, see user_controlled_walking.
+    if (replay) {
+        bc_port.setStrict();
+    }
+
     StoreData sd(200, rc.GetParts(), calib_file, simulation, out_loc);
 
     // Connect reader to external commands (possibly ai thread).
@@ -263,20 +280,25 @@ int main(int argc, char *argv[]) {
     for (const auto& part : rc.GetParts()) {
         for (const auto& camera : part.cameras) {
 
-            yarp::os::Network::connect("/read_cameras/" + camera, "/store_data/" + camera);
+            // Images are read from shared memory, if it is enabled, or replayed.
+            if (!YAML::LoadFile(io_config)["shared_images"].as<bool>() && !replay) {
+                yarp::os::Network::connect("/read_cameras/" + camera, "/store_data/" + camera);
+            }
         }
     }
     yarp::os::Network::connect("/reader/epoch", "/store_data/epoch");
 
     // Put reader, processor, and writer together.
-    yarp::os::Network::connect(rj.GetPortName(), "/behavioural_cloning/nmpc_pattern_generator");    // connect reader to BehaviouralCloning -> onRead gets called
+    if (!replay) {
+        yarp::os::Network::connect(rj.GetPortName(), "/behavioural_cloning/nmpc_pattern_generator");    // connect reader to BehaviouralCloning -> onRead gets called
+    }
     yarp::os::Network::connect("/behavioural_cloning/joint_angles", wj.GetPortName()); // connect to port_q of BehaviouralCloning
     yarp::os::Network::connect("/behavioural_cloning/robot_status", "/user_interface/robot_status"); // send robot status from keyreader to this main
     yarp::os::Network::connect("/write_joints/robot_status", "/user_interface/robot_status"); // send commands from writer.cpp to terminal
     yarp::os::Network::connect("/write_joints/robot_status", "/behavioural_cloning/robot_status"); // send commands from writer.cpp to this main
 
-    // Read force torque.
-    if (!simulation) {
+    // Read force torque, unless it is replayed.
+    if (!simulation && !replay) {
     
         yarp::os::Network::connect("/wholeBodyDynamics/left_leg/cartesianEndEffectorWrench:o", "/behavioural_cloning/lft"); // read force torques from yarp to behavioural_cloning
         yarp::os::Network::connect("/wholeBodyDynamics/right_leg/cartesianEndEffectorWrench:o", "/behavioural_cloning/rft"); // read force torques from yarp to behavioural_cloning
@@ -285,7 +307,11 @@ int main(int argc, char *argv[]) {
     // Start the read and write threads.
     rj.start();
     wj.start();
-    rc.start();
+
+    // Replayed images come from replay_traffic.
+    if (!replay) {
+        rc.start();
+    }
 
     // Start the store data thread.
     sd.start();
@@ -393,8 +419,8 @@ BehaviouralCloning::~BehaviouralCloning() {
 // Implement onRead() method.
 void  BehaviouralCloning::onRead(yarp::sig::Matrix& state) {
 
-    // Stop pattern generation on emergency stop.
-    if (!yarp::os::Network::isConnected(port_status_.getName(), "/user_interface/robot_status")) {
+    // Stop pattern generation on emergency stop. The user interface does not run during a replay.
+    if (!replay && !yarp::os::Network::isConnected(port_status_.getName(), "/user_interface/robot_status")) {
         std::cout << "Quitting pattern generation on emergency stop." << std::endl;
         this->interrupt();
         interrupted = true;
@@ -576,6 +602,12 @@ StoreData::StoreData(int period, std::vector<Part> parts, std::string calib_file
       epoch_(0),
       parts_(parts),
 
+      // Stereo, rectified with the calibration on the real robot.
+      stereo_(calib_file, !sim, ReadStereoConfigs(YAML::LoadFile(io_config)), ReadRealtimeConfigs(YAML::LoadFile(io_config), "stereo")),
+
+      // Dataset, written asynchronously.
+      writer_(out_location, ReadDatasetWriterConfigs(YAML::LoadFile(io_config)), ReadRealtimeConfigs(YAML::LoadFile(io_config), "dataset_writer")),
+
       // Position initialized.
       robot_status_(NOT_INITIALIZED),
       initialized_(false)
@@ -593,35 +625,46 @@ StoreData::StoreData(int period, std::vector<Part> parts, std::string calib_file
     }
 
     port_epoch_.open("/store_data/epoch");
+
+    // Shared memory, opened once the reader created it.
+    YAML::Node io_configs = YAML::LoadFile(io_config);
+
+    // Replayed images arrive on the ports.
+    shared_images_ = io_configs["shared_images"].as<bool>() && !replay;
+    pair_tol_ = io_configs["shared_images_pair_tol"].as<double>();
+    last_written_ = 0;
+
+    for (const auto& part : parts_) {
+        for (const auto& camera : part.cameras) {
+
+            rings_[camera].reset(new SharedImageRing("/read_cameras_" + camera));
+        }
+    }
  
     // Set initial velocity to zero.
     vel_.setZero();
+}
+
+
+bool StoreData::threadInit() {
+
+    // Keep the stereo processing away from the cores of the control threads.
+    SetRealtime(ReadRealtimeConfigs(YAML::LoadFile(io_config), "stereo"), "stereo");
 
-    // Stereo matching and weighted least square filter.
-    l_matcher_ = cv::StereoBM::create(32, 13);
-    r_matcher_ = cv::ximgproc::createRightMatcher(l_matcher_);
-    wls_ = cv::ximgproc::createDisparityWLSFilter(l_matcher_);
-
-    wls_->setLambda(1.e4);
-    wls_->setSigmaColor(1.);
-
-    // Calibration.
-    simulation_ = sim;
-    calib_initialized_ = false;
-
-    cv::FileStorage fs1(calib_file, cv::FileStorage::READ);
-    fs1["K1"] >> K1_;
-    fs1["K2"] >> K2_;
-    fs1["D1"] >> D1_;
-    fs1["D2"] >> D2_;
-    fs1["R"] >> R_;
-    fs1["T"] >> T_;
-
-    fs1["R1"] >> R1_;
-    fs1["R2"] >> R2_;
-    fs1["P1"] >> P1_;
-    fs1["P2"] >> P2_;
-    fs1["Q"] >> Q_;
+    stereo_.Start();
+
+    return true;
+}
+
+
+void StoreData::threadRelease() {
+
+    stereo_.Stop();
+    stereo_.Print();
+
+    // Write the pending records.
+    writer_.Close();
+    writer_.Print();
 }
 
 
@@ -672,90 +715,97 @@ void StoreData::ProcessImages() {
     // Read the camera images.
     bool null = true;
 
-    for (const auto& part : parts_) {
-        for (const auto& camera : part.cameras) {
+    if (shared_images_) {
 
-            yarp::sig::ImageOf<yarp::sig::PixelRgb>* img = ports_img_[camera].read(false);
-            if (img != YARP_NULLPTR) {
+        null = !ReadSharedImages();
+    }
+    else {
 
-                // Convert the images to a format that OpenCV uses.
-                imgs_cv_rgb_[camera] = cv::cvarrToMat(img->getIplImage());
+        imgs_time_ = yarp::os::Time::now();
 
-                if (calib_initialized_ && !simulation_) {
+        for (const auto& part : parts_) {
+            for (const auto& camera : part.cameras) {
 
-                    if (camera == "left") {
+                yarp::sig::ImageOf<yarp::sig::PixelRgb>* img = ports_img_[camera].read(false);
+                if (img != YARP_NULLPTR) {
 
-                        cv::remap(imgs_cv_rgb_[camera], imgs_cv_rgb_[camera], lmapx_, lmapy_, cv::INTER_LINEAR);
-                    }
-                    else {
+                    // Convert the images to a format that OpenCV uses.
+                    imgs_cv_rgb_[camera] = cv::cvarrToMat(img->getIplImage());
 
-                        cv::remap(imgs_cv_rgb_[camera], imgs_cv_rgb_[camera], rmapx_, rmapy_, cv::INTER_LINEAR);
-                    }
+                    null = false;
                 }
-
-                // Convert to gray image.
-                cv::cvtColor(imgs_cv_rgb_[camera], imgs_cv_gra_[camera], cv::COLOR_BGR2GRAY);
-
-                null = false;
             }
         }
     }
 
-    if (!null) {
+    yarp::os::Bottle* epoch = port_epoch_.read(false);
+    if (epoch != YARP_NULLPTR) {
+        epoch_ = epoch->get(0).asInt();
+    }
 
-        if (calib_initialized_) {
+    // Hand the pair over to the stereo pipeline, labelled with the velocity and the
+    // epoch at capture. Drop it, if the reader overwrote the shared images in the meantime.
+    if (!null && imgs_cv_rgb_.size() == 2) {
 
-            // Determine disparity.
-            l_matcher_->compute(imgs_cv_gra_[parts_[0].cameras[0]], imgs_cv_gra_[parts_[0].cameras[1]], l_disp_);
+        vel_sample_.assign(vel_.data(), vel_.data() + vel_.size());
 
-            r_matcher_->compute(imgs_cv_gra_[parts_[0].cameras[1]], imgs_cv_gra_[parts_[0].cameras[0]], r_disp_);
+        stereo_.Push(imgs_cv_rgb_[parts_[0].cameras[0]], imgs_cv_rgb_[parts_[0].cameras[1]], imgs_time_, vel_sample_, epoch_, [this]() {
+            if (shared_images_) {
+                for (const auto& frame : frames_) {
+                    if (!rings_[frame.first]->Valid(frame.second)) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        });
+    }
 
-            // Perform weighted least squares filtering.
-            wls_->filter(l_disp_, imgs_cv_gra_[parts_[0].cameras[0]], wls_disp_, r_disp_);
+    // Store the latest disparity.
+    if (stereo_.Pop(frame_)) {
 
-            cv::ximgproc::getDisparityVis(wls_disp_, wls_disp_, 1);
-            cv::normalize(wls_disp_, wls_disp_, 0, 255, CV_MINMAX, CV_8U);
+        // Set the time stamp.
+        time_stamp_ = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time_);
 
-            // Set the time stamp.
-            time_stamp_ = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time_);
+        // Record images with time stamp, and the velocity and epoch of their capture.
+        // Records are dropped and reported by the writer, if the disk does not keep up.
+        record_.epoch = frame_.epoch;
+        record_.time_stamp = time_stamp_.count();
+        record_.left = frame_.left;
+        record_.disparity = frame_.disparity;
+        record_.vel.assign(frame_.vel.begin(), frame_.vel.end());
+        record_.crop = stereo_.ScaleCrop(writer_.GetConfigs().shard_crop, frame_.left.size());
 
-            yarp::os::Bottle* epoch = port_epoch_.read(false);
-            if (epoch != YARP_NULLPTR) {
-                epoch_ = epoch->get(0).asInt();
-            }
+        writer_.Push(record_);
+    }
+}
 
-            // Record images with time stamp.
-            // Fill stringstream with preceeding zeros.
-            std::ostringstream ss;
-            ss << std::setw(8) << std::setfill('0') << std::to_string(time_stamp_.count());
 
-            // Track locations of stored images and corresponding velocity.
-            std::ofstream txt(out_location_ + "/log.txt", std::ios_base::app);
+bool StoreData::ReadSharedImages() {
 
-            std::string loc = out_location_ + "/data/img/left_epoch_" + std::to_string(epoch_) + "_" + ss.str() + ".jpg";
-            cv::imwrite(loc, imgs_cv_rgb_["left"]);
-            txt << "data/img/left_epoch_" + std::to_string(epoch_) + "_" + ss.str() + ".jpg" + ", ";
+    const std::string& l_cam = parts_[0].cameras[0];
+    const std::string& r_cam = parts_[0].cameras[1];
 
+    if (!rings_[l_cam]->Open() || !rings_[r_cam]->Open()) {
+        return false;
+    }
 
-            loc = out_location_ + "/data/img/wls_disp_epoch_" + std::to_string(epoch_) + "_" + ss.str() + ".jpg";
-            cv::imwrite(loc, wls_disp_);
-            txt << "data/img/wls_disp_epoch_" + std::to_string(epoch_) + "_" + ss.str() + ".jpg" + ", ";
+    // Latest left image, and the right image closest in time.
+    if (!rings_[l_cam]->ReadLatest(frames_[l_cam]) || frames_[l_cam].written == last_written_ ||
+        !rings_[r_cam]->ReadClosest(frames_[l_cam].time, frames_[r_cam]) ||
+        std::abs(frames_[l_cam].time - frames_[r_cam].time) > pair_tol_) {
+        return false;
+    }
 
-            int i = 0;
-            while (i < vel_.size()-1) {
-                txt << vel_[i] << ", ";
-                i++;
-            }
-            txt << vel_[vel_.size()-1] << "\n";
-        }
-        else {
+    last_written_ = frames_[l_cam].written;
+    imgs_time_ = frames_[l_cam].time;
 
-            if (!simulation_) {
-                cv::initUndistortRectifyMap(K1_, D1_, R1_, P1_, imgs_cv_rgb_["left"].size(), CV_32F, lmapx_, lmapy_);
-                cv::initUndistortRectifyMap(K2_, D2_, R2_, P2_, imgs_cv_rgb_["right"].size(), CV_32F, rmapx_, rmapy_);
-            }
+    // Views into shared memory, without copies.
+    for (const auto& frame : frames_) {
 
-            calib_initialized_ = true;
-        }
+        const SharedFrame& f = frame.second;
+        imgs_cv_rgb_[frame.first] = cv::Mat(f.height, f.width, f.channels == 1 ? CV_8UC1 : CV_8UC3, const_cast<unsigned char*>(f.data));
     }
+
+    return true;
 }
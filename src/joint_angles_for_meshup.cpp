@@ -42,9 +42,9 @@ int main() {
     bool init = false;
 
     // State of the robot.
-    Eigen::MatrixXd com_traj(4, 1);
-    Eigen::MatrixXd lf_traj(4, 1);
-    Eigen::MatrixXd rf_traj(4, 1);
+    Eigen::MatrixXd com_traj(4, 0);
+    Eigen::MatrixXd lf_traj(4, 0);
+    Eigen::MatrixXd rf_traj(4, 0);
 
     // Pattern generator preparation.
     nmpc.SetSecurityMargin(nmpc.SecurityMarginX(), 
@@ -85,18 +85,17 @@ int main() {
         pg_state = nmpc.Update();
         nmpc.SetInitialValues(pg_state);
 
-        // Inverse kinematics.
-        q_traj.conservativeResize(q_traj.rows() + traj.cols(), q_traj.cols());
+        // Collect the pattern for the inverse kinematics.
+        com_traj.conservativeResize(com_traj.rows(), com_traj.cols() + traj.cols());
+        lf_traj.conservativeResize(lf_traj.rows(), lf_traj.cols() + traj.cols());
+        rf_traj.conservativeResize(rf_traj.rows(), rf_traj.cols() + traj.cols());
         time.conservativeResize(time.rows() + traj.cols(), time.cols());
 
         for (int j = 0; j < traj.cols(); j++)
         {
-            com_traj << traj(0, j),  traj(3, j),  traj(6, j),  traj(7, j);
-            lf_traj << traj(13, j), traj(14, j), traj(15, j), traj(16, j);
-            rf_traj << traj(17, j), traj(18, j), traj(19, j), traj(20, j);  
-
-            ki.Inverse(com_traj, lf_traj, rf_traj);
-            q_traj.row(i*traj.cols() + j) = ki.GetQTraj().transpose();
+            com_traj.rightCols(traj.cols()).col(j) << traj(0, j),  traj(3, j),  traj(6, j),  traj(7, j);
+            lf_traj.rightCols(traj.cols()).col(j) << traj(13, j), traj(14, j), traj(15, j), traj(16, j);
+            rf_traj.rightCols(traj.cols()).col(j) << traj(17, j), traj(18, j), traj(19, j), traj(20, j);  
 
             t += interpol_nmpc.GetCommandPeriod();
             time(i*traj.cols() + j) = t;
@@ -146,6 +145,12 @@ int main() {
     }
 
 
+    // Inverse kinematics on the whole pattern, solved in parallel.
+    ki.InverseBatch(com_traj, lf_traj, rf_traj);
+
+    q_traj.conservativeResize(q_traj.rows() + com_traj.cols(), q_traj.cols());
+    q_traj.topRows(com_traj.cols()) = ki.GetQTraj().transpose();
+
     // Save results to .csv file and format it for meshup to read it properly.
     Eigen::MatrixXd result(q_traj.rows(), 22);
     result << time, q_traj;
@@ -0,0 +1,689 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <yarp/os/all.h>
+#include <yarp/dev/all.h>
+#include <yarp/sig/all.h>
+#include <yaml-cpp/yaml.h>
+
+// Forward declare location of the configuration file.
+std::string io_config;
+
+// Forward declare name of the robot.
+std::string robot;
+
+// Stop on ctrl+c.
+std::atomic<bool> interrupted(false);
+
+void Interrupt(int) { interrupted = true; }
+
+
+// LoopbackMotors implements the interfaces of a control board,
+// which ReadJoints and WriteJoints use. Every joint follows its
+// reference with a first order lag of time constant tau, or with
+// the reference speed in position control mode.
+class LoopbackMotors : public yarp::dev::DeviceDriver,
+                       public yarp::dev::IEncodersTimed,
+                       public yarp::dev::IControlLimits,
+                       public yarp::dev::IControlMode,
+                       public yarp::dev::IPositionControl,
+                       public yarp::dev::IPositionDirect,
+                       public yarp::os::RateThread
+{
+    public:
+
+        LoopbackMotors() : RateThread(1) { };
+
+        // Methods to be implemented for DeviceDriver.
+        virtual bool open(yarp::os::Searchable& config);
+
+        virtual bool close();
+
+        // IEncodersTimed, in degree.
+        virtual bool getAxes(int* ax) { *ax = n_; return true; };
+        virtual bool resetEncoder(int j) { return setEncoder(j, 0.); };
+        virtual bool resetEncoders() { for (int j = 0; j < n_; j++) { setEncoder(j, 0.); } return true; };
+        virtual bool setEncoder(int j, double val);
+        virtual bool setEncoders(const double* vals) { for (int j = 0; j < n_; j++) { setEncoder(j, vals[j]); } return true; };
+        virtual bool getEncoder(int j, double* v) { return Get(q_, j, v); };
+        virtual bool getEncoders(double* encs) { return Get(q_, encs); };
+        virtual bool getEncoderSpeed(int j, double* sp) { return Get(dq_, j, sp); };
+        virtual bool getEncoderSpeeds(double* spds) { return Get(dq_, spds); };
+        virtual bool getEncoderAcceleration(int j, double* spds) { return Get(ddq_, j, spds); };
+        virtual bool getEncoderAccelerations(double* accs) { return Get(ddq_, accs); };
+        virtual bool getEncodersTimed(double* encs, double* time);
+        virtual bool getEncoderTimed(int j, double* encs, double* time);
+
+        // IControlLimits.
+        virtual bool setLimits(int j, double min, double max);
+        virtual bool getLimits(int j, double* min, double* max);
+        virtual bool setVelLimits(int j, double min, double max) { return true; };
+        virtual bool getVelLimits(int j, double* min, double* max) { *min = 0.; *max = max_vel_; return true; };
+
+        // IControlMode.
+        virtual bool getControlMode(int j, int* mode) { return Get(mode_, j, mode); };
+        virtual bool getControlModes(int* modes) { return Get(mode_, modes); };
+        virtual bool getControlModes(const int n, const int* joints, int* modes);
+        virtual bool setControlMode(const int j, const int mode);
+        virtual bool setControlModes(const int n, const int* joints, int* modes);
+        virtual bool setControlModes(int* modes) { for (int j = 0; j < n_; j++) { setControlMode(j, modes[j]); } return true; };
+
+        // IPositionControl.
+        virtual bool positionMove(int j, double ref);
+        virtual bool positionMove(const double* refs) { for (int j = 0; j < n_; j++) { positionMove(j, refs[j]); } return true; };
+        virtual bool positionMove(const int n, const int* joints, const double* refs);
+        virtual bool relativeMove(int j, double delta);
+        virtual bool relativeMove(const double* deltas) { for (int j = 0; j < n_; j++) { relativeMove(j, deltas[j]); } return true; };
+        virtual bool relativeMove(const int n, const int* joints, const double* deltas);
+        virtual bool checkMotionDone(int j, bool* flag);
+        virtual bool checkMotionDone(bool* flag);
+        virtual bool checkMotionDone(const int n, const int* joints, bool* flag);
+        virtual bool setRefSpeed(int j, double sp) { return Set(ref_vel_, j, sp); };
+        virtual bool setRefSpeeds(const double* spds) { return Set(ref_vel_, spds); };
+        virtual bool setRefSpeeds(const int n, const int* joints, const double* spds) { return Set(ref_vel_, n, joints, spds); };
+        virtual bool setRefAcceleration(int j, double acc) { return true; };
+        virtual bool setRefAccelerations(const double* accs) { return true; };
+        virtual bool setRefAccelerations(const int n, const int* joints, const double* accs) { return true; };
+        virtual bool getRefSpeed(int j, double* ref) { return Get(ref_vel_, j, ref); };
+        virtual bool getRefSpeeds(double* spds) { return Get(ref_vel_, spds); };
+        virtual bool getRefSpeeds(const int n, const int* joints, double* spds) { return Get(ref_vel_, n, joints, spds); };
+        virtual bool getRefAcceleration(int j, double* acc) { *acc = 0.; return true; };
+        virtual bool getRefAccelerations(double* accs) { std::fill(accs, accs + n_, 0.); return true; };
+        virtual bool getRefAccelerations(const int n, const int* joints, double* accs) { std::fill(accs, accs + n, 0.); return true; };
+        virtual bool stop(int j);
+        virtual bool stop() { for (int j = 0; j < n_; j++) { stop(j); } return true; };
+        virtual bool stop(const int n, const int* joints) { for (int i = 0; i < n; i++) { stop(joints[i]); } return true; };
+        virtual bool getTargetPosition(const int j, double* ref) { return Get(q_ref_, j, ref); };
+        virtual bool getTargetPositions(double* refs) { return Get(q_ref_, refs); };
+        virtual bool getTargetPositions(const int n, const int* joints, double* refs) { return Get(q_ref_, n, joints, refs); };
+
+        // IPositionDirect.
+        virtual bool setPosition(int j, double ref) { return Set(q_ref_, j, ref); };
+        virtual bool setPositions(const int n, const int* joints, const double* refs) { return Set(q_ref_, n, joints, refs); };
+        virtual bool setPositions(const double* refs) { return Set(q_ref_, refs); };
+        virtual bool getRefPosition(const int j, double* ref) { return Get(q_ref_, j, ref); };
+        virtual bool getRefPositions(double* refs) { return Get(q_ref_, refs); };
+        virtual bool getRefPositions(const int n, const int* joints, double* refs) { return Get(q_ref_, n, joints, refs); };
+
+    private:
+
+        // Method to be implemented for RateThread, integrates the tracking model.
+        virtual void run();
+
+        // Thread safe access to the joint values.
+        template<typename T>
+        bool Get(const std::vector<T>& v, int j, T* out);
+
+        template<typename T>
+        bool Get(const std::vector<T>& v, T* out);
+
+        template<typename T>
+        bool Get(const std::vector<T>& v, int n, const int* joints, T* out);
+
+        bool Set(std::vector<double>& v, int j, double in);
+
+        bool Set(std::vector<double>& v, const double* in);
+
+        bool Set(std::vector<double>& v, int n, const int* joints, const double* in);
+
+        // Number of joints, time constant and period of the tracking model in seconds.
+        int n_;
+        double tau_;
+        double period_;
+        double max_vel_;
+
+        // State and references, in degree.
+        std::vector<double> q_, dq_, ddq_;
+        std::vector<double> q_ref_, ref_vel_;
+        std::vector<double> q_min_, q_max_;
+        std::vector<int> mode_;
+
+        std::mutex mutex_;
+};
+
+
+// LoopbackCamera implements a frame grabber, which produces
+// synthetic images with a pattern that moves over time. The
+// pattern of every camera is shifted by a constant disparity,
+// so that stereo matching has something to work on.
+class LoopbackCamera : public yarp::dev::DeviceDriver,
+                       public yarp::dev::IFrameGrabberImage
+{
+    public:
+
+        // Methods to be implemented for DeviceDriver.
+        virtual bool open(yarp::os::Searchable& config);
+
+        // IFrameGrabberImage.
+        virtual bool getImage(yarp::sig::ImageOf<yarp::sig::PixelRgb>& image);
+        virtual int height() const { return height_; };
+        virtual int width() const { return width_; };
+
+    private:
+
+        int width_;
+        int height_;
+        int disparity_;
+        double period_;
+
+        // Time of the last image, to limit the frame rate.
+        double last_;
+        int frame_;
+};
+
+
+// Main application for the loopback robot.
+int main(int argc, char *argv[]) {
+
+    // Read user input to obtain the location of the configuration
+    // file and the robot's name.
+    yarp::os::Property params;
+    params.fromCommand(argc, argv);
+
+    if (params.check("io_config")) {
+        io_config = params.find("io_config").asString();
+    }
+    else {
+        std::cerr << "Please specify the location of the input output configurations file" << std::endl;
+        std::cerr << "--io_config (e.g. ../libs/io_module/configs.yaml)" << std::endl;
+        std::exit(1);
+    }
+    if (params.check("robot")) {
+        robot = params.find("robot").asString();
+    }
+    else {
+        std::cerr << "Please specify name of the robot" << std::endl;
+        std::cerr << "--robot (e.g. loopback)" << std::endl;
+        std::exit(1);
+    }
+
+    // Tracking model and cameras.
+    double tau = params.check("tau", yarp::os::Value(0.02)).asDouble();
+    double period = params.check("period", yarp::os::Value(1e-3)).asDouble();
+    double fps = params.check("fps", yarp::os::Value(30.)).asDouble();
+
+    // Set up the yarp network, a name server on this machine suffices.
+    yarp::os::Network yarp;
+
+    // Make the devices known to YARP.
+    yarp::dev::Drivers::factory().add(new yarp::dev::DriverCreatorOf<LoopbackMotors>("loopback_motors", "controlboardwrapper2", "LoopbackMotors"));
+    yarp::dev::Drivers::factory().add(new yarp::dev::DriverCreatorOf<LoopbackCamera>("loopback_camera", "grabber", "LoopbackCamera"));
+
+    // Collect the parts that are read or written, and the cameras.
+    YAML::Node configs = YAML::LoadFile(io_config);
+
+    std::map<std::string, int> parts;
+    std::vector<std::string> cameras;
+
+    for (const auto& group : {"motors", "sensors"}) {
+        for (YAML::const_iterator part = configs[group].begin(); part != configs[group].end(); part++) {
+
+            std::string name = (*part)["part"].as<std::string>();
+
+            if ((*part)["joints"]) {
+                for (const auto& j : (*part)["joints"].as<std::vector<int>>()) {
+                    parts[name] = std::max(parts[name], j + 1);
+                }
+            }
+
+            if ((*part)["cameras"]) {
+                for (const auto& camera : (*part)["cameras"].as<std::vector<std::string>>()) {
+                    if (std::find(cameras.begin(), cameras.end(), camera) == cameras.end()) {
+                        cameras.push_back(camera);
+                    }
+                }
+            }
+        }
+    }
+
+    // Serve every part and camera under the names, which the readers and writers expect.
+    std::vector<yarp::dev::PolyDriver*> dd;
+
+    for (const auto& part : parts) {
+
+        yarp::os::Property options;
+        options.put("device", "controlboardwrapper2");
+        options.put("subdevice", "loopback_motors");
+        options.put("name", "/" + robot + "/" + part.first);
+        options.put("joints", part.second);
+        options.put("tau", tau);
+        options.put("period", period);
+
+        dd.push_back(new yarp::dev::PolyDriver(options));
+    }
+
+    for (uint i = 0; i < cameras.size(); i++) {
+
+        yarp::os::Property options;
+        options.put("device", "grabber");
+        options.put("subdevice", "loopback_camera");
+        options.put("name", "/" + robot + "/cam/" + cameras[i]);
+        options.put("framerate", fps);
+        options.put("disparity", int(8*i));
+
+        dd.push_back(new yarp::dev::PolyDriver(options));
+    }
+
+    for (const auto& d : dd) {
+
+        if (!d->isValid()) {
+            std::cerr << "Could not open loopback devices." << std::endl;
+            std::exit(1);
+        }
+    }
+
+    std::cout << "Loopback robot " << robot << " with " << parts.size() << " parts and " << cameras.size() << " cameras is running." << std::endl;
+
+    // Run until ctrl+c.
+    std::signal(SIGINT, Interrupt);
+    std::signal(SIGTERM, Interrupt);
+
+    while (!interrupted) {
+        yarp::os::Time::delay(1e-1);
+    }
+
+    // Close and delete drivers.
+    for (auto& d : dd) {
+        d->close();
+        delete d;
+    }
+
+    return 0;
+}
+
+
+// Implement LoopbackMotors.
+bool LoopbackMotors::open(yarp::os::Searchable& config) {
+
+    n_ = config.check("joints", yarp::os::Value(1)).asInt();
+    tau_ = config.check("tau", yarp::os::Value(0.02)).asDouble();
+    period_ = config.check("period", yarp::os::Value(1e-3)).asDouble();
+    max_vel_ = config.check("max_vel", yarp::os::Value(360.)).asDouble();
+
+    q_.assign(n_, 0.);
+    dq_.assign(n_, 0.);
+    ddq_.assign(n_, 0.);
+    q_ref_.assign(n_, 0.);
+    ref_vel_.assign(n_, 10.);
+    q_min_.assign(n_, -180.);
+    q_max_.assign(n_, 180.);
+    mode_.assign(n_, VOCAB_CM_POSITION);
+
+    setRate(period_*1e3);
+
+    return start();
+}
+
+
+bool LoopbackMotors::close() {
+
+    stop();
+    RateThread::stop();
+
+    return true;
+}
+
+
+void LoopbackMotors::run() {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (int j = 0; j < n_; j++) {
+
+        double dq;
+
+        if (mode_[j] == VOCAB_CM_POSITION) {
+
+            // Move to the target with the reference speed.
+            double step = ref_vel_[j]*period_;
+            dq = std::max(-step, std::min(step, q_ref_[j] - q_[j]))/period_;
+        }
+        else if (mode_[j] == VOCAB_CM_POSITION_DIRECT) {
+
+            // First order lag, discretized exactly.
+            dq = (q_ref_[j] - q_[j])*(1. - std::exp(-period_/tau_))/period_;
+        }
+        else {
+
+            dq = 0.;
+        }
+
+        dq = std::max(-max_vel_, std::min(max_vel_, dq));
+
+        ddq_[j] = (dq - dq_[j])/period_;
+        dq_[j] = dq;
+        q_[j] = std::max(q_min_[j], std::min(q_max_[j], q_[j] + dq*period_));
+    }
+}
+
+
+bool LoopbackMotors::setEncoder(int j, double val) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (j < 0 || j >= n_) {
+        return false;
+    }
+
+    q_[j] = val;
+    q_ref_[j] = val;
+
+    return true;
+}
+
+
+bool LoopbackMotors::getEncodersTimed(double* encs, double* time) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    double now = yarp::os::Time::now();
+
+    for (int j = 0; j < n_; j++) {
+        encs[j] = q_[j];
+        time[j] = now;
+    }
+
+    return true;
+}
+
+
+bool LoopbackMotors::getEncoderTimed(int j, double* encs, double* time) {
+
+    *time = yarp::os::Time::now();
+
+    return getEncoder(j, encs);
+}
+
+
+bool LoopbackMotors::setLimits(int j, double min, double max) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (j < 0 || j >= n_) {
+        return false;
+    }
+
+    q_min_[j] = min;
+    q_max_[j] = max;
+
+    return true;
+}
+
+
+bool LoopbackMotors::getLimits(int j, double* min, double* max) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (j < 0 || j >= n_) {
+        return false;
+    }
+
+    *min = q_min_[j];
+    *max = q_max_[j];
+
+    return true;
+}
+
+
+bool LoopbackMotors::getControlModes(const int n, const int* joints, int* modes) {
+
+    return Get(mode_, n, joints, modes);
+}
+
+
+bool LoopbackMotors::setControlMode(const int j, const int mode) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (j < 0 || j >= n_) {
+        return false;
+    }
+
+    // Hold the current position after switching.
+    mode_[j] = mode;
+    q_ref_[j] = q_[j];
+
+    return true;
+}
+
+
+bool LoopbackMotors::setControlModes(const int n, const int* joints, int* modes) {
+
+    bool ok = true;
+
+    for (int i = 0; i < n; i++) {
+        ok = ok && setControlMode(joints[i], modes[i]);
+    }
+
+    return ok;
+}
+
+
+bool LoopbackMotors::positionMove(int j, double ref) {
+
+    return Set(q_ref_, j, ref);
+}
+
+
+bool LoopbackMotors::positionMove(const int n, const int* joints, const double* refs) {
+
+    return Set(q_ref_, n, joints, refs);
+}
+
+
+bool LoopbackMotors::relativeMove(int j, double delta) {
+
+    double ref;
+
+    return getTargetPosition(j, &ref) && positionMove(j, ref + delta);
+}
+
+
+bool LoopbackMotors::relativeMove(const int n, const int* joints, const double* deltas) {
+
+    bool ok = true;
+
+    for (int i = 0; i < n; i++) {
+        ok = ok && relativeMove(joints[i], deltas[i]);
+    }
+
+    return ok;
+}
+
+
+bool LoopbackMotors::checkMotionDone(int j, bool* flag) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (j < 0 || j >= n_) {
+        return false;
+    }
+
+    *flag = std::abs(q_ref_[j] - q_[j]) < 1e-2;
+
+    return true;
+}
+
+
+bool LoopbackMotors::checkMotionDone(bool* flag) {
+
+    *flag = true;
+
+    for (int j = 0; j < n_; j++) {
+
+        bool done;
+        checkMotionDone(j, &done);
+        *flag = *flag && done;
+    }
+
+    return true;
+}
+
+
+bool LoopbackMotors::checkMotionDone(const int n, const int* joints, bool* flag) {
+
+    *flag = true;
+
+    for (int i = 0; i < n; i++) {
+
+        bool done;
+
+        if (!checkMotionDone(joints[i], &done)) {
+            return false;
+        }
+
+        *flag = *flag && done;
+    }
+
+    return true;
+}
+
+
+bool LoopbackMotors::stop(int j) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (j < 0 || j >= n_) {
+        return false;
+    }
+
+    q_ref_[j] = q_[j];
+
+    return true;
+}
+
+
+template<typename T>
+bool LoopbackMotors::Get(const std::vector<T>& v, int j, T* out) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (j < 0 || j >= n_) {
+        return false;
+    }
+
+    *out = v[j];
+
+    return true;
+}
+
+
+template<typename T>
+bool LoopbackMotors::Get(const std::vector<T>& v, T* out) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::copy(v.begin(), v.end(), out);
+
+    return true;
+}
+
+
+template<typename T>
+bool LoopbackMotors::Get(const std::vector<T>& v, int n, const int* joints, T* out) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (int i = 0; i < n; i++) {
+
+        if (joints[i] < 0 || joints[i] >= n_) {
+            return false;
+        }
+
+        out[i] = v[joints[i]];
+    }
+
+    return true;
+}
+
+
+bool LoopbackMotors::Set(std::vector<double>& v, int j, double in) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (j < 0 || j >= n_) {
+        return false;
+    }
+
+    v[j] = in;
+
+    return true;
+}
+
+
+bool LoopbackMotors::Set(std::vector<double>& v, const double* in) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::copy(in, in + n_, v.begin());
+
+    return true;
+}
+
+
+bool LoopbackMotors::Set(std::vector<double>& v, int n, const int* joints, const double* in) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (int i = 0; i < n; i++) {
+
+        if (joints[i] < 0 || joints[i] >= n_) {
+            return false;
+        }
+
+        v[joints[i]] = in[i];
+    }
+
+    return true;
+}
+
+
+// Implement LoopbackCamera.
+bool LoopbackCamera::open(yarp::os::Searchable& config) {
+
+    width_ = config.check("width", yarp::os::Value(320)).asInt();
+    height_ = config.check("height", yarp::os::Value(240)).asInt();
+    disparity_ = config.check("disparity", yarp::os::Value(0)).asInt();
+    period_ = 1./config.check("framerate", yarp::os::Value(30.)).asDouble();
+
+    last_ = 0.;
+    frame_ = 0;
+
+    return true;
+}
+
+
+bool LoopbackCamera::getImage(yarp::sig::ImageOf<yarp::sig::PixelRgb>& image) {
+
+    // Behave like a camera, that delivers images at its frame rate.
+    double wait = last_ + period_ - yarp::os::Time::now();
+
+    if (wait > 0.) {
+        yarp::os::Time::delay(wait);
+    }
+
+    last_ = yarp::os::Time::now();
+
+    // Stripes that move to the right, over a vertical gradient.
+    image.resize(width_, height_);
+
+    for (int y = 0; y < height_; y++) {
+        for (int x = 0; x < width_; x++) {
+
+            yarp::sig::PixelRgb& p = image.pixel(x, y);
+
+            unsigned char stripe = ((x + disparity_ + 2*frame_)/16) % 2 ? 200 : 50;
+
+            p.r = stripe;
+            p.g = (unsigned char)(255*y/height_);
+            p.b = (unsigned char)((x*y + frame_) % 256);
+        }
+    }
+
+    frame_++;
+
+    return true;
+}
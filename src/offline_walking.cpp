@@ -153,6 +153,22 @@ int main(int argc, char *argv[]) {
     ki.Inverse(com_traj, lf_traj, rf_traj);
     Eigen::MatrixXd q_traj = ki.GetQTraj().bottomRows(15);
 
+    // Solve the inverse kinematics for the remaining pattern in parallel, before
+    // anything is sent to the robot.
+    Eigen::MatrixXd com_batch(4, traj.cols() - 1);
+    Eigen::MatrixXd lf_batch(4, traj.cols() - 1);
+    Eigen::MatrixXd rf_batch(4, traj.cols() - 1);
+
+    com_batch << traj.block(0, 1, 1, traj.cols() - 1),  traj.block(3, 1, 1, traj.cols() - 1),  traj.block(6, 1, 1, traj.cols() - 1),  traj.block(7, 1, 1, traj.cols() - 1);
+    lf_batch  << traj.block(13, 1, 1, traj.cols() - 1), traj.block(14, 1, 1, traj.cols() - 1), traj.block(15, 1, 1, traj.cols() - 1), traj.block(16, 1, 1, traj.cols() - 1);
+    rf_batch  << traj.block(17, 1, 1, traj.cols() - 1), traj.block(18, 1, 1, traj.cols() - 1), traj.block(19, 1, 1, traj.cols() - 1), traj.block(20, 1, 1, traj.cols() - 1);
+
+    ki.InverseBatch(com_batch, lf_batch, rf_batch);
+    Eigen::MatrixXd q_batch = ki.GetQTraj().bottomRows(15);
+
+    // Where the inverse kinematics spent its time.
+    ki.GetStatistics().Print();
+
     // Write joint angles to output port.
     yarp::sig::Vector data(q_traj.rows(), 1);
     Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(data.data(), q_traj.rows(), 1) = q_traj.col(0);
@@ -195,15 +211,8 @@ int main(int argc, char *argv[]) {
         yarp::os::Time::delay(double(period)/1000.); // convert to seconds
         std::cout << i << std::endl;
 
-        com_traj << traj(0, i),  traj(3, i),  traj(6, i),  traj(7, i);
-        lf_traj << traj(13, i), traj(14, i), traj(15, i), traj(16, i);
-        rf_traj << traj(17, i), traj(18, i), traj(19, i), traj(20, i);  
-
-        ki.Inverse(com_traj, lf_traj, rf_traj);
-        q_traj = ki.GetQTraj().bottomRows(15);
-
         // Write joint angles to output port.
-        Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(data.data(), q_traj.rows(), 1) = q_traj.col(0);
+        Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(data.data(), q_batch.rows(), 1) = q_batch.col(i - 1);
 
         port.prepare() = data;
         port.write();
@@ -0,0 +1,97 @@
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <yarp/os/all.h>
+#include <yaml-cpp/yaml.h>
+
+#include "traffic_log.h"
+
+// Forward declare location of the configuration file.
+std::string io_config;
+
+// Forward declare location of the log.
+std::string out;
+
+// Stop on ctrl+c.
+std::atomic<bool> interrupted(false);
+
+void Interrupt(int) { interrupted = true; }
+
+
+// Main application to record the traffic on the ports of the io
+// configurations, for replay_traffic to reproduce it later on.
+int main(int argc, char *argv[]) {
+
+    // Read user input to obtain the location of the configuration
+    // file and the log.
+    yarp::os::Property params;
+    params.fromCommand(argc, argv);
+
+    if (params.check("io_config")) {
+        io_config = params.find("io_config").asString();
+    }
+    else {
+        std::cerr << "Please specify the location of the input output configurations file" << std::endl;
+        std::cerr << "--io_config (e.g. ../libs/io_module/configs.yaml)" << std::endl;
+        std::exit(1);
+    }
+    if (params.check("out")) {
+        out = params.find("out").asString();
+    }
+    else {
+        std::cerr << "Please specify the location of the log" << std::endl;
+        std::cerr << "--out (e.g. traffic.log)" << std::endl;
+        std::exit(1);
+    }
+
+    // Set up the yarp network.
+    yarp::os::Network yarp;
+
+    // Ports to record.
+    YAML::Node configs = YAML::LoadFile(io_config);
+    std::vector<std::string> ports;
+
+    for (const auto& traffic : configs["traffic"]) {
+        ports.push_back(traffic["port"].as<std::string>());
+    }
+
+    TrafficLogWriter log(out, ports);
+
+    // Tap every port. Ports, which do not exist yet, are connected later on.
+    std::vector<std::unique_ptr<TrafficTap>> taps;
+    std::vector<bool> connected(ports.size(), false);
+
+    for (uint i = 0; i < ports.size(); i++) {
+
+        taps.emplace_back(new TrafficTap(log, i));
+        connected[i] = taps[i]->Open("/record_traffic" + ports[i], ports[i]);
+    }
+
+    std::cout << "Recording to " << out << ", stop with ctrl+c." << std::endl;
+
+    std::signal(SIGINT, Interrupt);
+    std::signal(SIGTERM, Interrupt);
+
+    while (!interrupted) {
+
+        for (uint i = 0; i < ports.size(); i++) {
+            if (!connected[i]) {
+                connected[i] = yarp::os::Network::connect(ports[i], "/record_traffic" + ports[i], "tcp");
+            }
+        }
+
+        yarp::os::Time::delay(1e-1);
+    }
+
+    // Close ports before the log, so that no message arrives after the index.
+    for (uint i = 0; i < ports.size(); i++) {
+
+        taps[i]->Close();
+        std::cout << ports[i] << ": " << taps[i]->GetCount() << " messages" << std::endl;
+    }
+
+    log.Close();
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <yarp/os/all.h>
+#include <yaml-cpp/yaml.h>
+
+#include "traffic_log.h"
+
+// Forward declare locations of the configuration file and the log.
+std::string io_config;
+std::string log_loc;
+
+// Stop on ctrl+c.
+std::atomic<bool> interrupted(false);
+
+void Interrupt(int) { interrupted = true; }
+
+
+// Main application to replay a log of record_traffic. Every
+// recorded port is served as /replay_traffic/<port>, and connected
+// to the destinations of the io configurations. Messages are sent
+// at their recorded times, scaled by --speed, or as fast as possible
+// with --speed 0. Applications started with --replay true queue the
+// replayed joint states and force torques, so that none is dropped,
+// if they are sent faster than processed. These applications still
+// need a robot, usually the loopback robot, for their reader and writer.
+int main(int argc, char *argv[]) {
+
+    // Read user input to obtain the location of the configuration
+    // file and the log.
+    yarp::os::Property params;
+    params.fromCommand(argc, argv);
+
+    if (params.check("io_config")) {
+        io_config = params.find("io_config").asString();
+    }
+    else {
+        std::cerr << "Please specify the location of the input output configurations file" << std::endl;
+        std::cerr << "--io_config (e.g. ../libs/io_module/configs.yaml)" << std::endl;
+        std::exit(1);
+    }
+    if (params.check("log")) {
+        log_loc = params.find("log").asString();
+    }
+    else {
+        std::cerr << "Please specify the location of the log" << std::endl;
+        std::cerr << "--log (e.g. traffic.log)" << std::endl;
+        std::exit(1);
+    }
+
+    double speed = params.check("speed", yarp::os::Value(1.)).asDouble();  // 0 replays as fast as possible
+    double start = params.check("start", yarp::os::Value(0.)).asDouble();  // seconds to skip
+    double wait  = params.check("wait", yarp::os::Value(5.)).asDouble();   // seconds to wait for the destinations
+
+    // Set up the yarp network.
+    yarp::os::Network yarp;
+
+    TrafficLogReader log(log_loc);
+
+    if (log.GetSize() == 0) {
+        std::cerr << "Traffic log " << log_loc << " is empty." << std::endl;
+        std::exit(1);
+    }
+
+    // Destinations of the recorded ports.
+    YAML::Node configs = YAML::LoadFile(io_config);
+    std::map<std::string, std::vector<std::string>> destinations;
+
+    for (const auto& traffic : configs["traffic"]) {
+        destinations[traffic["port"].as<std::string>()] = traffic["destinations"].as<std::vector<std::string>>();
+    }
+
+    // Serve the recorded ports.
+    const std::vector<std::string>& channels = log.GetChannels();
+    std::vector<std::unique_ptr<yarp::os::Port>> ports;
+
+    for (const auto& channel : channels) {
+
+        ports.emplace_back(new yarp::os::Port);
+
+        if (!ports.back()->open("/replay_traffic" + channel)) {
+            std::cerr << "Could not open port /replay_traffic" << channel << std::endl;
+            std::exit(1);
+        }
+    }
+
+    std::signal(SIGINT, Interrupt);
+    std::signal(SIGTERM, Interrupt);
+
+    // Connect to the destinations, while the applications come up.
+    double t_wait = yarp::os::Time::now() + wait;
+
+    while (!interrupted && yarp::os::Time::now() < t_wait) {
+
+        for (uint i = 0; i < channels.size(); i++) {
+            for (const auto& destination : destinations[channels[i]]) {
+
+                std::string name = "/replay_traffic" + channels[i];
+
+                if (!yarp::os::Network::isConnected(name, destination)) {
+                    yarp::os::Network::connect(name, destination, "tcp");
+                }
+            }
+        }
+
+        yarp::os::Time::delay(5e-1);
+    }
+
+    for (uint i = 0; i < channels.size(); i++) {
+        std::cout << channels[i] << ": " << ports[i]->getOutputCount() << " destinations" << std::endl;
+    }
+
+    // Replay. Envelopes are shifted by the same offset as the messages,
+    // so that their relative timing is kept.
+    uint64_t first = log.Seek(log.GetIndex()[0].time + start);
+    double t0_log = first < log.GetSize() ? log.GetIndex()[first].time : 0.;
+    double t0 = yarp::os::Time::now();
+
+    TrafficMessage msg;
+    RawMessage raw;
+    double late = 0.;
+    uint64_t count = 0;
+
+    for (uint64_t i = first; i < log.GetSize() && !interrupted; i++) {
+
+        if (!log.Read(i, msg)) {
+            std::cerr << "Could not read message " << i << " of the traffic log." << std::endl;
+            break;
+        }
+
+        double offset = t0 - t0_log;
+
+        if (speed > 0.) {
+
+            double t = t0 + (msg.time - t0_log)/speed;
+            double dt = t - yarp::os::Time::now();
+
+            if (dt > 0.) {
+                yarp::os::Time::delay(dt);
+            }
+            else {
+                late = std::max(late, -dt);
+            }
+
+            offset = t - msg.time;
+        }
+
+        if (msg.count >= 0) {
+            yarp::os::Stamp stamp(msg.count, msg.stamp + offset);
+            ports[msg.channel]->setEnvelope(stamp);
+        }
+
+        raw.data.swap(msg.data);
+        ports[msg.channel]->write(raw);
+        count++;
+    }
+
+    std::cout << "Replayed " << count << " messages in " << yarp::os::Time::now() - t0 << " s";
+    if (speed > 0.) {
+        std::cout << ", at most " << late << " s late";
+    }
+    std::cout << "." << std::endl;
+
+    for (auto& port : ports) {
+        port->close();
+    }
+
+    return 0;
+}
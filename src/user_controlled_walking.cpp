@@ -1,9 +1,16 @@
+#include <atomic>
 #include <yarp/os/all.h>
 #include <Eigen/Core>
 #include <rbdl/rbdl.h>
 #include <qpOASES.hpp>
 
 #include "reader.h"
+#include "async_csv_writer.h"
+#include "heartbeat.h"
+#include "pipeline.h"
+#include "realtime.h"
+#include "sensor_buffer.h"
+#include "tick_statistics.h"
 #include "writer.h"
 #include "nmpc_generator.h"
 #include "mpc_generator.h"
@@ -22,6 +29,20 @@ std::string robot;
 // Forward declare simulation.
 bool simulation;
 
+// Forward declare replay of recorded traffic.
+bool replay;
+
+// Work item, which is handed from one stage of the WalkingProcessor to the next.
+struct WalkingItem {
+
+    double time;           // time stamp of the joint state
+    Eigen::MatrixXd state; // joint state
+    Eigen::Vector3d com;   // measured center of mass
+    Eigen::MatrixXd traj;  // interpolated step of the pattern
+    Eigen::MatrixXd q;     // joint angles, per column of the step
+};
+
+
 // Forward declare WalkingProcessor. This is actually the heart
 // of the application. Within it, the pattern is generated,
 // and the  inverse kinematics is computed.
@@ -36,14 +57,33 @@ class WalkingProcessor : public yarp::os::BufferedPort<yarp::sig::Matrix>
         using yarp::os::BufferedPort<yarp::sig::Matrix>::onRead;
         virtual void onRead(yarp::sig::Matrix& state);
 
+        // Process a joint state, which is read from the port, or
+        // from the in-process transport, together with its time stamp.
+        // Once initialized, a joint state per period of the pattern
+        // generator is handed to the pipeline.
+        void Process(const Eigen::MatrixXd& state, double time);
+
+        // Stages of the pipeline. Estimate obtains the com feedback, Plan
+        // generates the next step of the pattern, Invert computes its joint
+        // angles, and Output writes them.
+        bool Estimate(WalkingItem& item);
+        bool Plan(WalkingItem& item);
+        bool Invert(WalkingItem& item);
+        bool Output(WalkingItem& item);
+
         // Setter.
         inline void SetRobotStatus(RobotStatus stat) { robot_status_ = stat; };
+        inline void SetCommandBuffer(Mailbox<JointCommand>* commands) { commands_ = commands; };
+        inline void SetSegmentBuffer(Mailbox<JointSegment>* segments) { segments_ = segments; };
 
-        // State of this port.
-        bool interrupted;
+        // State of this port, set by the port callback and read by the stages.
+        std::atomic<bool> interrupted;
 
     public: // TEST.. change to private!
 
+        // Configurations of the io module.
+        YAML::Node io_configs_;
+
         // Building blocks of walking generation.
         NMPCGenerator pg_;
         Interpolation ip_;
@@ -76,8 +116,6 @@ class WalkingProcessor : public yarp::os::BufferedPort<yarp::sig::Matrix>
         // External velocity input and joint angle port.
         yarp::os::BufferedPort<yarp::sig::Vector> port_vel_;
         yarp::os::BufferedPort<yarp::sig::Vector> port_q_;
-        yarp::os::BufferedPort<yarp::sig::Vector> port_lft_;
-        yarp::os::BufferedPort<yarp::sig::Vector> port_rft_;
 
         // Mutex.
         yarp::os::Mutex mutex_;
@@ -86,12 +124,65 @@ class WalkingProcessor : public yarp::os::BufferedPort<yarp::sig::Matrix>
         RobotStatus robot_status_;
         bool initialized_;
 
-        // Port to communicate the status.
+        // Port to communicate the status, written by several stages.
         yarp::os::BufferedPort<yarp::os::Bottle> port_status_;
+        yarp::os::Mutex status_mutex_;
+
+        void WriteStatus(const std::string& key, int value);
 
-        // Force torque.
+        // Force torque, buffered by port callbacks, aligned with the joint
+        // states and written to disk by a background thread.
         bool simulation_;
-        Eigen::MatrixXd ft_;
+        SensorBuffer lft_;
+        SensorBuffer rft_;
+        Eigen::VectorXd ft_;
+        std::unique_ptr<AsyncCsvWriter> ft_log_;
+
+        // Write joint angles to the in-process transport, or to the port.
+        void WriteCommand(const Eigen::MatrixXd& q);
+
+        Mailbox<JointCommand>* commands_;
+        JointCommand joint_command_;
+
+        // Write the whole segment of the preview horizon at once, for the writer
+        // to stream it with a spline, to the in-process transport, or to the port.
+        void WriteSegment();
+
+        bool stream_;
+        yarp::os::BufferedPort<yarp::sig::Matrix> port_segment_;
+        Mailbox<JointSegment>* segments_;
+        JointSegment joint_segment_;
+        double t_knot_;
+
+        // Real-time settings, applied by the thread which runs the pattern generator.
+        RealtimeConfigs rt_configs_;
+        bool rt_set_;
+
+        // Latency from the joint state to writing the first command, published on a port.
+        TickStatistics latency_;
+        yarp::os::BufferedPort<yarp::os::Bottle> port_stats_;
+        double t_output_;
+
+        // Pipeline of the stages, which feeds a joint state per period of the pattern generator.
+        Pipeline<WalkingItem> pipeline_;
+        RealtimeConfigs pipeline_rt_configs_;
+        WalkingItem item_;
+        double t_push_;
+
+        // Forward kinematics of the estimation stage, with the floating base of the latest inverse kinematics.
+        Kinematics ki_fk_;
+        Eigen::VectorXd base_;
+        yarp::os::Mutex base_mutex_;
+
+        // Com feedback, optionally predicted by the latency of the pipeline. The time of the
+        // joint state, latency, measured com, predicted and planned com are written to disk.
+        bool com_feedback_;
+        bool latency_compensation_;
+        Eigen::VectorXd com_row_;
+        std::unique_ptr<AsyncCsvWriter> com_log_;
+
+        // Watchdog on the heartbeats of the user interface, reader and writer.
+        Watchdog watchdog_;
 };
 
 
@@ -144,6 +235,11 @@ int main(int argc, char *argv[]) {
         std::exit(1);
     }
 
+    // Replay of recorded traffic, see replay_traffic. The reader and the writer
+    // still run against --robot, for the joint limits and the commands, so a
+    // replay needs a robot, usually the loopback robot.
+    replay = params.check("replay") && params.find("replay").asBool();
+
     // Set up the yarp network.
     yarp::os::Network yarp;
 
@@ -162,22 +258,44 @@ int main(int argc, char *argv[]) {
     WalkingProcessor pg_port(min, max, simulation); 
     pg_port.open("/user_controlled_walking/nmpc_pattern_generator");
 
+    // A replay at maximum speed sends faster than the callbacks take the messages.
+    // Queue all of them, instead of only the latest, so that every replayed joint
+    // state and force torque is processed in order.
+    if (replay) {
+        pg_port.setStrict();
+        pg_port.lft_.SetStrict();
+        pg_port.rft_.SetStrict();
+    }
+
+    // Exchange joint states and commands without ports, if everything runs in this process.
+    const bool in_process = !replay && rj.GetTransport() == "in_process" && wj.GetTransport() == "in_process";
+
+    if (in_process) {
+        pg_port.SetCommandBuffer(&wj.GetCommandBuffer());
+        pg_port.SetSegmentBuffer(&wj.GetSegmentBuffer());
+    }
+
     // Connect reader to external commands (possibly ai thread).
     yarp::os::Network::connect("/reader/vel", "/user_controlled_walking/vel"); // send commands from terminal (reader.cpp) to this main
     yarp::os::Network::connect("/reader/robot_status", "/user_controlled_walking/robot_status"); // send robot status from keyreader to this main
 
     // Put reader, processor, and writer together.
-    yarp::os::Network::connect(rj.GetPortName(), "/user_controlled_walking/nmpc_pattern_generator");    // connect reader to walkingprocessor -> onRead gets called
-    yarp::os::Network::connect("/user_controlled_walking/joint_angles", wj.GetPortName()); // connect to port_q of walkingprocessor
+    if (!in_process) {
+        if (!replay) {
+            yarp::os::Network::connect(rj.GetPortName(), "/user_controlled_walking/nmpc_pattern_generator");    // connect reader to walkingprocessor -> onRead gets called
+        }
+        yarp::os::Network::connect("/user_controlled_walking/joint_angles", wj.GetPortName()); // connect to port_q of walkingprocessor
+        yarp::os::Network::connect("/user_controlled_walking/joint_segments", wj.GetSegmentPortName()); // connect to port_segment of walkingprocessor
+    }
     yarp::os::Network::connect("/user_controlled_walking/robot_status", "/user_interface/robot_status"); // send robot status from keyreader to this main
     yarp::os::Network::connect("/write_joints/robot_status", "/user_interface/robot_status"); // send commands from writer.cpp to terminal
     yarp::os::Network::connect("/write_joints/robot_status", "/user_controlled_walking/robot_status"); // send commands from writer.cpp to this main
 
-    // Read force torque.
-    if (!simulation) {
+    // Read force torque, unless it is replayed.
+    if (!simulation && !replay) {
     
-        yarp::os::Network::connect("/wholeBodyDynamics/left_leg/cartesianEndEffectorWrench:o", "/user_controlled_walking/lft"); // read force torques from yarp to user_controlled_walking.cpp
-        yarp::os::Network::connect("/wholeBodyDynamics/right_leg/cartesianEndEffectorWrench:o", "/user_controlled_walking/rft"); // read force torques from yarp to user_controlled_walking.cpp
+        yarp::os::Network::connect("/wholeBodyDynamics/left_leg/cartesianEndEffectorWrench:o", pg_port.lft_.GetPortName()); // read force torques from yarp to user_controlled_walking.cpp
+        yarp::os::Network::connect("/wholeBodyDynamics/right_leg/cartesianEndEffectorWrench:o", pg_port.rft_.GetPortName()); // read force torques from yarp to user_controlled_walking.cpp
     }
 
     // Start the read and write threads.
@@ -185,18 +303,53 @@ int main(int argc, char *argv[]) {
     wj.start();
     
     // Run program for a certain delay.
-    while (!pg_port.interrupted) {
+    if (in_process) {
+
+        // Poll the latest joint state from the reader, and process it in this thread.
+        JointState joint_state{0., Eigen::MatrixXd::Zero(min.size(), 3)};
+
+        while (!pg_port.interrupted) {
+
+            if (rj.GetStateBuffer().PopLatest(joint_state)) {
+                pg_port.Process(joint_state.state, joint_state.time);
+            }
+            else {
+                yarp::os::Time::delay(1e-4);
+            }
+        }
+    }
+    else {
+
+        while (!pg_port.interrupted) {
 
-        // Run until port is disconnected.
-        yarp::os::Time::delay(1e-1);
+            // Run until port is disconnected.
+            yarp::os::Time::delay(1e-1);
+        }
     }
 
+    // Let the stages finish, and dump their statistics.
+    pg_port.pipeline_.Stop();
+    pg_port.pipeline_.Print();
+
     // Save trajectories.
     WriteCsv("user_controlled_walking_trajectories.csv", pg_port.ip_.GetTrajectories().transpose());
+
+    // Dump the joint state to write latency.
+    pg_port.latency_.Print();
+
+    // Save inverse kinematics statistics.
+    pg_port.ki_.GetStatistics().Print();
+    pg_port.ki_.GetStatistics().WriteCsv("user_controlled_walking_ik_statistics.csv");
     
+    // Write the remaining com feedback.
+    pg_port.com_log_->Close();
+    std::cout << "Com feedback: " << pg_port.com_log_->GetWritten() << " rows written, " << pg_port.com_log_->GetDropped() << " dropped." << std::endl;
+
     if (!simulation) {
 
-        WriteCsv("force_torque.csv", pg_port.ft_.transpose());
+        // Write the remaining force torques.
+        pg_port.ft_log_->Close();
+        std::cout << "Force torque: " << pg_port.ft_log_->GetWritten() << " rows written, " << pg_port.ft_log_->GetDropped() << " dropped." << std::endl;
     }
 
     // Stop reader and writer (on command later).
@@ -212,6 +365,9 @@ int main(int argc, char *argv[]) {
 WalkingProcessor::WalkingProcessor(Eigen::VectorXd q_min, Eigen::VectorXd q_max, bool sim)
   : interrupted(false),
 
+    // Configurations of the io module, loaded once.
+    io_configs_(YAML::LoadFile(io_config)),
+
     pg_(pg_config),
     ip_(pg_), 
     ki_(ki_config),
@@ -234,7 +390,47 @@ WalkingProcessor::WalkingProcessor(Eigen::VectorXd q_min, Eigen::VectorXd q_max,
     initialized_(false),
     
     simulation_(sim),
-    ft_(12, 0) {
+    lft_(io_configs_["force_torque_buffer_size"].as<int>(), 6),
+    rft_(io_configs_["force_torque_buffer_size"].as<int>(), 6),
+    ft_(15),
+    
+    // Port transport by default.
+    commands_(YARP_NULLPTR),
+
+    // Stream segments, if the writer samples them with a spline.
+    stream_(io_configs_["stream_period"].as<double>() > 0.),
+    segments_(YARP_NULLPTR),
+    t_knot_(0.),
+
+    // Real-time settings.
+    rt_configs_(ReadRealtimeConfigs(io_configs_, "walking_processor")),
+    rt_set_(false),
+
+    // Latency, the deadline is one period of the pattern generator.
+    latency_("walking_processor", pg_.T(),
+             io_configs_["stats_bin"].as<double>(),
+             io_configs_["stats_bins"].as<int>(),
+             io_configs_["stats_miss_tol"].as<double>()),
+    t_output_(0.),
+
+    // Pipeline.
+    pipeline_(io_configs_["pipeline_queue_size"].as<int>()),
+    pipeline_rt_configs_(ReadRealtimeConfigs(io_configs_, "walking_pipeline")),
+    t_push_(0.),
+    ki_fk_(ki_config),
+    base_(Eigen::VectorXd::Zero(6)),
+
+    // Com feedback.
+    com_feedback_(io_configs_["com_feedback"].as<bool>()),
+    latency_compensation_(io_configs_["latency_compensation"].as<bool>()),
+    com_row_(9),
+    com_log_(new AsyncCsvWriter("com_feedback.csv", 9)),
+
+    // Watchdog.
+    watchdog_("user_controlled_walking",
+              io_configs_["heartbeat_period"].as<double>(),
+              io_configs_["heartbeat_timeout"].as<double>(),
+              io_configs_["heartbeat_grace"].as<double>()) {
 
     // Pattern generator preparation.
     pg_.SetSecurityMargin(pg_.SecurityMarginX(), 
@@ -266,30 +462,79 @@ WalkingProcessor::WalkingProcessor(Eigen::VectorXd q_min, Eigen::VectorXd q_max,
     // Open port for velocity input.
     port_vel_.open("/user_controlled_walking/vel"); // open /user_controlled_walking/vel port to read velocity commands from terminal via reader.cpp
     port_q_.open("/user_controlled_walking/joint_angles"); // open /user_controlled_walking/joint_angles port to read joint angles from writer.cpp
-    port_lft_.open("/user_controlled_walking/lft"); // open /user_controlled_walking/lft to read in force torque from yarp
-    port_rft_.open("/user_controlled_walking/rft"); // open /user_controlled_walking/rft to read in force torque from yarp
+    lft_.Open("/user_controlled_walking/lft"); // open /user_controlled_walking/lft to read in force torque from yarp
+    rft_.Open("/user_controlled_walking/rft"); // open /user_controlled_walking/rft to read in force torque from yarp
     port_status_.open("/user_controlled_walking/robot_status"); // open /user_controlled_walking/robot_status to write status information to the terminal via reader.cpp
+    port_stats_.open("/user_controlled_walking/stats"); // open /user_controlled_walking/stats to publish the solve to write latency
+    port_segment_.open("/user_controlled_walking/joint_segments"); // open /user_controlled_walking/joint_segments to write trajectory segments to writer.cpp
 
     ip_.StoreTrajectories(true);
+
+    // Monitor the heartbeats. The user interface does not run during a replay.
+    if (!replay) {
+        watchdog_.Watch("/user_interface/heartbeat");
+    }
+    watchdog_.Watch("/read_joints/heartbeat");
+    watchdog_.Watch("/write_joints/heartbeat");
+    watchdog_.start();
+
+    // Stages of the pipeline. Only the estimation may skip joint states, and drop
+    // them once they are too old, the later stages must not miss a step of the pattern.
+    const double deadline = io_configs_["pipeline_deadline"].as<double>()*pg_.T();
+
+    auto rt = [this](const std::string& stage) {
+        return [this, stage]() { SetRealtime(pipeline_rt_configs_, "walking_pipeline/" + stage); };
+    };
+
+    pipeline_.AddStage("estimation", [this](WalkingItem& item) { return Estimate(item); }, deadline, true, rt("estimation"));
+    pipeline_.AddStage("nmpc",       [this](WalkingItem& item) { return Plan(item);     }, 0., false, rt("nmpc"));
+    pipeline_.AddStage("ik",         [this](WalkingItem& item) { return Invert(item);   }, 0., false, rt("ik"));
+    pipeline_.AddStage("output",     [this](WalkingItem& item) { return Output(item);   }, 0., false, rt("output"));
+
+    // Time of the joint state, left and right force torque, and their distance in time to the closest sample.
+    if (!simulation_) {
+        ft_log_.reset(new AsyncCsvWriter("force_torque.csv", ft_.size()));
+    }
 }
 
 
 WalkingProcessor::~WalkingProcessor() {
 
+    watchdog_.stop();
+    pipeline_.Stop();
+
     // Close ports.
     port_vel_.close();
     port_q_.close();
-    port_lft_.close();
-    port_rft_.close();
+    lft_.Close();
+    rft_.Close();
     port_status_.close();
+    port_stats_.close();
+    port_segment_.close();
 }
 
 
 // Implement onRead() method.
 void  WalkingProcessor::onRead(yarp::sig::Matrix& state) {
 
-    // Stop pattern generation on emergency stop.
-    if (!yarp::os::Network::isConnected(port_status_.getName(), "/user_interface/robot_status")) {
+    // Time stamp of the reader, or the time of arrival.
+    yarp::os::Stamp stamp;
+    double time = getEnvelope(stamp) && stamp.isValid() ? stamp.getTime() : yarp::os::Time::now();
+
+    Process(yarp::eigen::toEigen(state), time);
+}
+
+
+void WalkingProcessor::Process(const Eigen::MatrixXd& state, double time) {
+
+    // Scheduling, affinity and memory of the thread that runs the pattern generator.
+    if (!rt_set_) {
+        SetRealtime(rt_configs_, "walking_processor");
+        rt_set_ = true;
+    }
+
+    // Stop pattern generation on emergency stop, or if a heartbeat is missing.
+    if (watchdog_.EmergencyStop()) {
         std::cout << "Quitting pattern generation on emergency stop." << std::endl;
         this->interrupt();
         interrupted = true;
@@ -312,116 +557,30 @@ void  WalkingProcessor::onRead(yarp::sig::Matrix& state) {
 
     if (initialized_ && robot_status_ == INITIALIZED && !interrupted) {
 
-        // Read the desired velocity and keep it unchanged if
-        // no command arrives.
-        yarp::sig::Vector* vel = port_vel_.read(false);
-        if (vel != YARP_NULLPTR) {
-
-            // Convert to Eigen.
-            vel_ = yarp::eigen::toEigen(*vel);
-        }
-
-        // Set desired velocity.
-        pg_.SetVelocityReference(vel_);
+        // Start a step every period of the pattern generator, while the
+        // stages still work on the previous ones.
+        if (time - t_push_ > pg_.T() - 0.5*ip_.GetCommandPeriod()) {
 
-        // Solve QP.
-        pg_.Solve();
-        pg_.Simulate();
-        traj_ = ip_.InterpolateStep();
+            item_.time = time;
+            item_.state = state;
 
-        if (pg_.GetStatus() != qpOASES::SUCCESSFUL_RETURN) {
-
-            // Communicate unfeasible qp.
-            yarp::os::Bottle& bottle = port_status_.prepare();
-            yarp::os::Property& dict = bottle.addDict();
-
-            dict.put("ERROR", QP_INFEASIBLE);
-            port_status_.write(); // write status to port which calls onRead() method of KeyReader or AppReader and is received by the app
-
-            std::exit(1);
-        }
-
-        // Use forward kinematics to obtain the com feedback.
-        q_ << ki_.GetQTraj().topRows(6).col(0), yarp::eigen::toEigen(state.getCol(0)).bottomRows(15);
-
-        ki_.Forward(q_, dq_, ddq_);
-        com_pos_ = ki_.GetComPos();
-
-        // Generate pattern with com feedback.
-        pg_state_.com_x(0) = com_pos_(0);//, com_vel_(0), com_acc_(0);
-        pg_state_.com_y(0) = com_pos_(1);//, com_vel_(1), com_acc_(1);
-        pg_state_.com_z = com_pos_(2);
-
-        pg_state_ = pg_.Update();
-        pg_.SetInitialValues(pg_state_);
-
-        // Check for correctness of inverse kinematics.
-        if (!ki_.GetStatus()) {
-
-            // Communicate inverse kinematics status.
-            yarp::os::Bottle& bottle = port_status_.prepare();
-            yarp::os::Property& dict = bottle.addDict();
-
-            dict.put("Warning", IK_DID_NOT_CONVERGE);
-            port_status_.write(); // write status to port which calls onRead() method of KeyReader or AppReader and is received by the app
-        }
-
-        // Check for hardware limits.
-        bool limits = false;
-
-        limits = limits && (q_traj_.array() < q_min_.array()).any();
-        limits = limits && (q_traj_.array() > q_max_.array()).any();
-
-        if (limits) {
-
-            // Communicate hardware limits.
-            yarp::os::Bottle& bottle = port_status_.prepare();
-            yarp::os::Property& dict = bottle.addDict();
-
-            dict.put("ERROR", HARDWARE_LIMITS);
-            port_status_.write(); // write status to port which calls onRead() method of KeyReader or AppReader and is received by the app
-
-            std::exit(1);
+            if (pipeline_.Push(item_)) {
+                t_push_ = time;
+            }
         }
 
+        // Force torque at the time of the joint state.
         if (!simulation_) 
         {
-        
-            ft_.conservativeResize(ft_.rows(), ft_.cols() + ip_.GetTrajectoriesBuffer().cols());
-        }
-
-        for (int i = 0; i < traj_.cols(); i++)
-        {
-            com_traj_ << traj_(0, i),  traj_(3, i),  traj_(6, i),  traj_(7, i);
-            lf_traj_ << traj_(13, i), traj_(14, i), traj_(15, i), traj_(16, i);
-            rf_traj_ << traj_(17, i), traj_(18, i), traj_(19, i), traj_(20, i);  
-
-            if (!simulation_) 
-            {
-            
-                yarp::sig::Vector* lft = port_lft_.read();
-                yarp::sig::Vector* rft = port_rft_.read();
-
-                for (int j = 0; j < (*lft).size(); j++) {
-                    
-                    ft_(j, ft_.cols() - ip_.GetTrajectoriesBuffer().cols() + i) = (*lft)[j];
-                    ft_(j + (*lft).size(), ft_.cols() - ip_.GetTrajectoriesBuffer().cols() + i) = (*rft)[j];
-                }
-            }
+            ft_(0) = time;
 
-            ki_.Inverse(com_traj_, lf_traj_, rf_traj_);
-            q_traj_ = ki_.GetQTraj().bottomRows(15);
+            if (lft_.Align(time, ft_.segment(1, 6), &ft_(13)) &&
+                rft_.Align(time, ft_.segment(7, 6), &ft_(14))) {
 
-            // Write joint angles to output port.
-            yarp::sig::Vector data(q_traj_.rows(), q_traj_.cols());
-            Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(data.data(), q_traj_.rows(), q_traj_.cols()) = q_traj_;
-
-            port_q_.prepare() = data;
-            port_q_.write();
-
-            yarp::os::Time::delay(ip_.GetCommandPeriod()); // convert to seconds
+                ft_log_->Push(ft_);
+            }
         }
-     }
+    }
 
     else if (!initialized_ && !interrupted) {
 
@@ -451,15 +610,247 @@ void  WalkingProcessor::onRead(yarp::sig::Matrix& state) {
         q_traj_ = ki_.GetQTraj().bottomRows(15).col(0);
 
         // Write joint angles to output port.
-        yarp::sig::Vector data(q_traj_.rows(), q_traj_.cols());
-        Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(data.data(), q_traj_.rows(), q_traj_.cols()) = q_traj_;
+        WriteCommand(q_traj_);
 
-        port_q_.prepare() = data;
-        port_q_.write();
+        // Floating base for the com feedback.
+        base_mutex_.lock();
+        base_ = ki_.GetQTraj().topRows(6).col(0);
+        base_mutex_.unlock();
 
         initialized_ = true;
+
+        pipeline_.Start();
     }
 
     // Unlock the callback.
     unlockCallback();
 }
+
+
+bool WalkingProcessor::Estimate(WalkingItem& item) {
+
+    // Use forward kinematics to obtain the com feedback.
+    base_mutex_.lock();
+    q_ << base_, item.state.col(0).bottomRows(15);
+    base_mutex_.unlock();
+
+    ki_fk_.Forward(q_, dq_, ddq_);
+    item.com = ki_fk_.GetComPos();
+
+    return true;
+}
+
+
+bool WalkingProcessor::Plan(WalkingItem& item) {
+
+    // Read the desired velocity and keep it unchanged if
+    // no command arrives.
+    yarp::sig::Vector* vel = port_vel_.read(false);
+    if (vel != YARP_NULLPTR) {
+
+        // Convert to Eigen.
+        vel_ = yarp::eigen::toEigen(*vel);
+    }
+
+    // Set desired velocity.
+    pg_.SetVelocityReference(vel_);
+
+    // Predict the measured com to the time, at which the step is applied. That is
+    // the time, which passed since the measurement, and the recent durations of
+    // this and the inverse kinematics stage.
+    double latency = yarp::os::Time::now() - item.time +
+                     pipeline_.GetDuration(pipeline_.GetStage("nmpc")) +
+                     pipeline_.GetDuration(pipeline_.GetStage("ik"));
+
+    PatternGeneratorState measured = pg_state_;
+    measured.com_x(0) = item.com(0);
+    measured.com_y(0) = item.com(1);
+
+    PatternGeneratorState predicted = pg_.Predict(measured, latency);
+
+    // Generate pattern with com feedback.
+    if (com_feedback_) {
+        pg_.SetInitialValues(latency_compensation_ ? predicted : measured);
+    }
+
+    com_row_ << item.time, latency, item.com, predicted.com_x(0), predicted.com_y(0), pg_state_.com_x(0), pg_state_.com_y(0);
+    com_log_->Push(com_row_);
+
+    // Solve QP.
+    pg_.Solve();
+    pg_.Simulate();
+    item.traj = ip_.InterpolateStep();
+
+    if (pg_.GetStatus() != qpOASES::SUCCESSFUL_RETURN) {
+
+        // Communicate unfeasible qp.
+        WriteStatus("ERROR", QP_INFEASIBLE);
+
+        std::exit(1);
+    }
+
+    pg_state_ = pg_.Update();
+    pg_.SetInitialValues(pg_state_);
+
+    return true;
+}
+
+
+bool WalkingProcessor::Invert(WalkingItem& item) {
+
+    item.q.resize(ki_.GetQTraj().rows() - 6, item.traj.cols());
+
+    for (int i = 0; i < item.traj.cols(); i++)
+    {
+        com_traj_ << item.traj(0, i),  item.traj(3, i),  item.traj(6, i),  item.traj(7, i);
+        lf_traj_ << item.traj(13, i), item.traj(14, i), item.traj(15, i), item.traj(16, i);
+        rf_traj_ << item.traj(17, i), item.traj(18, i), item.traj(19, i), item.traj(20, i);  
+
+        ki_.Inverse(com_traj_, lf_traj_, rf_traj_);
+        item.q.col(i) = ki_.GetQTraj().bottomRows(15);
+    }
+
+    // Floating base for the com feedback of the next steps.
+    base_mutex_.lock();
+    base_ = ki_.GetQTraj().topRows(6).col(0);
+    base_mutex_.unlock();
+
+    // Check for correctness of inverse kinematics.
+    if (!ki_.GetStatus()) {
+
+        // Communicate inverse kinematics status.
+        WriteStatus("Warning", IK_DID_NOT_CONVERGE);
+    }
+
+    // Check for hardware limits.
+    bool limits = false;
+
+    limits = limits && (item.q.rowwise().minCoeff().array() < q_min_.array()).any();
+    limits = limits && (item.q.rowwise().maxCoeff().array() > q_max_.array()).any();
+
+    if (limits) {
+
+        // Communicate hardware limits.
+        WriteStatus("ERROR", HARDWARE_LIMITS);
+
+        std::exit(1);
+    }
+
+    return true;
+}
+
+
+bool WalkingProcessor::Output(WalkingItem& item) {
+
+    // Do not move anymore after an emergency stop.
+    if (interrupted) {
+        return false;
+    }
+
+    double t_start = yarp::os::Time::now();
+
+    if (stream_) {
+
+        // Knots follow each other at the command period, and the first one follows the
+        // last knot of the previous segment, so that jitter of this stage does not shift
+        // the trajectory. Re-anchor to one period from now, if the previous segment was
+        // missed or the segments run ahead by more than a segment.
+        const double period = ip_.GetCommandPeriod();
+        const int knots = item.q.cols();
+
+        double t_first = t_knot_ + period;
+
+        if (t_first <= t_start || t_first > t_start + (knots + 1)*period) {
+            t_first = t_start + period;
+        }
+
+        joint_segment_.q = item.q;
+        joint_segment_.time = t_first + period*Eigen::VectorXd::LinSpaced(knots, 0, knots - 1).array();
+        t_knot_ = joint_segment_.time(knots - 1);
+
+        WriteSegment();
+    }
+    else {
+
+        // Write the first joint angles, the others follow at the command period.
+        q_traj_ = item.q.col(0);
+        WriteCommand(q_traj_);
+    }
+
+    double now = yarp::os::Time::now();
+
+    latency_.Record(t_output_ > 0. ? now - t_output_ : pg_.T(), now - item.time);
+    latency_.Publish(port_stats_, 1.);
+    t_output_ = now;
+
+    if (!stream_) {
+
+        for (int i = 1; i < item.q.cols() && !interrupted; i++) {
+
+            yarp::os::Time::delay(ip_.GetCommandPeriod()); // convert to seconds
+
+            // Write joint angles to output port.
+            q_traj_ = item.q.col(i);
+            WriteCommand(q_traj_);
+        }
+    }
+
+    return true;
+}
+
+
+void WalkingProcessor::WriteStatus(const std::string& key, int value) {
+
+    status_mutex_.lock();
+
+    yarp::os::Bottle& bottle = port_status_.prepare();
+    yarp::os::Property& dict = bottle.addDict();
+
+    dict.put(key, value);
+    port_status_.write(); // write status to port which calls onRead() method of KeyReader or AppReader and is received by the app
+
+    status_mutex_.unlock();
+}
+
+
+void WalkingProcessor::WriteCommand(const Eigen::MatrixXd& q) {
+
+    if (commands_ != YARP_NULLPTR) {
+
+        // Hand the joint angles over to the writer in this process.
+        joint_command_.time = yarp::os::Time::now();
+        joint_command_.q = Eigen::Map<const Eigen::VectorXd>(q.data(), q.size());
+
+        commands_->Push(joint_command_);
+    }
+    else {
+
+        // Write joint angles to output port.
+        yarp::sig::Vector data(q.rows(), q.cols());
+        Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(data.data(), q.rows(), q.cols()) = q;
+
+        port_q_.prepare() = data;
+        port_q_.write();
+    }
+}
+
+
+void WalkingProcessor::WriteSegment() {
+
+    if (segments_ != YARP_NULLPTR) {
+
+        // Hand the segment over to the writer in this process.
+        segments_->Push(joint_segment_);
+    }
+    else {
+
+        // Write the times of the knots as first row, and the joint angles below.
+        yarp::sig::Matrix& data = port_segment_.prepare();
+        data.resize(joint_segment_.q.rows() + 1, joint_segment_.q.cols());
+
+        yarp::eigen::toEigen(data).row(0) = joint_segment_.time.transpose();
+        yarp::eigen::toEigen(data).bottomRows(joint_segment_.q.rows()) = joint_segment_.q;
+
+        port_segment_.write();
+    }
+}